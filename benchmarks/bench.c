@@ -0,0 +1,1099 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CDATA_THREADS
+#define CDATA_IMPLEMENTATION
+#include "cdata.h"
+
+// Each benchmark runs its operations in several samples. Only the run function
+// is timed, while setup and teardown prepare the state used by each sample.
+typedef void (*Bench_Fcn)(void *);
+
+typedef struct {
+    char *name;
+    char *params;
+    size_t ops; // Number of operations executed by each call to run
+    Bench_Fcn setup;
+    Bench_Fcn run;
+    Bench_Fcn teardown;
+    void *context;
+} Benchmark;
+
+typedef struct {
+    double mean;
+    double min;
+    double p50;
+    double p90;
+    double p99;
+} Bench_Result;
+
+typedef struct {
+    char name[128];
+    double p50;
+} Baseline;
+
+static size_t samples = 31;
+static volatile size_t sink = 0; // Keeps the compiler from removing the benchmarked code
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec*1e9 + (double)ts.tv_nsec;
+}
+
+// xorshift64*, so that every run uses the same sequence of keys
+static size_t rng_state = 0x9E3779B97F4A7C15UL;
+
+static size_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DUL;
+}
+
+static void rng_reset(void) {
+    rng_state = 0x9E3779B97F4A7C15UL;
+}
+
+int compare_size_t(const void *a, const void *b) {
+    const size_t x = *(const size_t *)a;
+    const size_t y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+int compare_u32(const void *a, const void *b) {
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+size_t hash_size_t(const void *data) {
+    // Finalizer of MurmurHash3, since the keys are random anyway
+    size_t x = *(const size_t *)data;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDUL;
+    x ^= x >> 33;
+    return x;
+}
+
+size_t hash_string(const void *data) {
+    return djb2(*(char *const *)data);
+}
+
+//------------------------------------------------------------------------------
+// Shared data sets
+
+static size_t *random_keys = NULL;
+static size_t *sorted_keys = NULL;
+static char **random_strings = NULL;
+static Arena strings_arena = { 0 };
+
+static void datasets_init(size_t count) {
+    rng_reset();
+    for (size_t i = 0; i < count; i++) {
+        const size_t key = rng_next();
+        array_push(random_keys, key);
+        array_push(sorted_keys, key);
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "key-%zx", key);
+        array_push(random_strings, arena_strdup(&strings_arena, buffer));
+    }
+    array_qsort(sorted_keys, compare_size_t);
+}
+
+static void datasets_delete(void) {
+    array_delete(random_keys);
+    array_delete(sorted_keys);
+    array_delete(random_strings);
+    arena_delete(&strings_arena);
+}
+
+//------------------------------------------------------------------------------
+// Dynamic arrays
+
+typedef struct {
+    size_t count;
+    size_t *array;
+    char **strings;
+} Array_Context;
+
+static void array_context_teardown(void *ctx) {
+    Array_Context *context = ctx;
+    array_delete(context->array);
+    array_delete(context->strings);
+    context->array = NULL;
+    context->strings = NULL;
+}
+
+static void bench_array_push(void *ctx) {
+    Array_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        array_push(context->array, i);
+    }
+    sink += array_size(context->array);
+}
+
+// Short lived arrays with a few elements, as in the functions which collect
+// some items and then discard them
+static void bench_array_push_small(void *ctx) {
+    Array_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        size_t *array = NULL;
+        array_push(array, i);
+        array_push(array, i + 1);
+        array_push(array, i + 2);
+        sink += array_size(array);
+        array_delete(array);
+    }
+}
+
+static void bench_array_push_small_storage(void *ctx) {
+    Array_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        array_storage(size_t, 8) storage;
+        size_t *array = NULL;
+        array_use_storage(array, storage);
+        array_push(array, i);
+        array_push(array, i + 1);
+        array_push(array, i + 2);
+        sink += array_size(array);
+        array_delete(array);
+    }
+}
+
+static void bench_array_insert_sorted(void *ctx) {
+    Array_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        array_insert_sorted(context->array, &random_keys[i], compare_size_t, NULL);
+    }
+    sink += array_size(context->array);
+}
+
+static void setup_sorted_array(void *ctx) {
+    Array_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        array_push(context->array, sorted_keys[i]);
+    }
+}
+
+static void bench_array_binary_search(void *ctx) {
+    Array_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        sink += array_binary_search(context->array, &random_keys[i], compare_size_t);
+    }
+}
+
+static void setup_random_array(void *ctx) {
+    Array_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        array_push(context->array, random_keys[i]);
+        array_push(context->strings, random_strings[i]);
+    }
+}
+
+static void bench_array_qsort(void *ctx) {
+    Array_Context *context = ctx;
+    array_qsort(context->array, compare_size_t);
+    sink += context->array[0];
+}
+
+static void bench_array_qsort_strings(void *ctx) {
+    Array_Context *context = ctx;
+    array_qsort(context->strings, compare_strings);
+    sink += (size_t)context->strings[0][0];
+}
+
+//------------------------------------------------------------------------------
+// Hash tables
+
+typedef struct {
+    size_t capacity;
+    size_t count; // capacity*load_factor
+    size_t *table;
+    char **strings;
+} Hash_Context;
+
+static void setup_hash_table(void *ctx) {
+    Hash_Context *context = ctx;
+    context->table = hash_table_new_with_capacity(size_t, hash_size_t, compare_size_t, context->capacity);
+    context->strings = hash_table_new_with_capacity(char *, hash_string, compare_strings, context->capacity);
+}
+
+static void setup_filled_hash_table(void *ctx) {
+    Hash_Context *context = ctx;
+    setup_hash_table(ctx);
+    for (size_t i = 0; i < context->count; i++) {
+        hash_table_insert(context->table, &random_keys[i], NULL);
+        hash_table_insert(context->strings, &random_strings[i], NULL);
+    }
+}
+
+static void teardown_hash_table(void *ctx) {
+    Hash_Context *context = ctx;
+    hash_table_delete(context->table);
+    hash_table_delete(context->strings);
+}
+
+static void bench_hash_table_insert(void *ctx) {
+    Hash_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        hash_table_insert(context->table, &random_keys[i], NULL);
+    }
+    sink += hash_table_size(context->table);
+}
+
+static void bench_hash_table_get(void *ctx) {
+    Hash_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        sink += (size_t)hash_table_get(context->table, &random_keys[i]);
+    }
+}
+
+static void bench_hash_table_insert_strings(void *ctx) {
+    Hash_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        hash_table_insert(context->strings, &random_strings[i], NULL);
+    }
+    sink += hash_table_size(context->strings);
+}
+
+static void bench_hash_table_get_strings(void *ctx) {
+    Hash_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        sink += (size_t)hash_table_get(context->strings, &random_strings[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Arena allocator
+
+typedef struct {
+    size_t count;
+    size_t size;
+    Arena arena;
+} Arena_Context;
+
+static void teardown_arena(void *ctx) {
+    Arena_Context *context = ctx;
+    arena_free_all(&context->arena);
+}
+
+static void bench_arena_alloc(void *ctx) {
+    Arena_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        char *ptr = arena_alloc(&context->arena, context->size);
+        ptr[0] = 0;
+    }
+}
+
+static void bench_arena_strdup(void *ctx) {
+    Arena_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        sink += (size_t)arena_strdup(&context->arena, random_strings[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Minimal perfect hash
+
+typedef struct {
+    size_t count;
+    Perfect_Hash perfect_hash;
+} Perfect_Hash_Context;
+
+static void setup_perfect_hash(void *ctx) {
+    Perfect_Hash_Context *context = ctx;
+    size_t *keys = NULL;
+    for (size_t i = 0; i < context->count; i++) {
+        array_push(keys, random_keys[i]);
+    }
+    const int status = perfect_hash_from_array(&context->perfect_hash, keys, hash_size_t, compare_size_t);
+    assert(status == 0);
+    (void)status;
+    array_delete(keys);
+}
+
+static void teardown_perfect_hash(void *ctx) {
+    Perfect_Hash_Context *context = ctx;
+    perfect_hash_delete(&context->perfect_hash);
+}
+
+static void bench_perfect_hash_get(void *ctx) {
+    Perfect_Hash_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        sink += (size_t)perfect_hash_get(&context->perfect_hash, &random_keys[i]);
+    }
+}
+
+static void bench_perfect_hash_build(void *ctx) {
+    Perfect_Hash_Context *context = ctx;
+    setup_perfect_hash(ctx);
+    sink += perfect_hash_size(&context->perfect_hash);
+}
+
+//------------------------------------------------------------------------------
+// Sorted set operations
+
+typedef struct {
+    size_t range_a;
+    size_t range_b;
+    uint32_t *a;
+    uint32_t *b;
+    uint32_t *output;
+} Set_Context;
+
+// Each value in the range is present with probability 1/2
+static uint32_t *random_set(size_t range) {
+    uint32_t *set = NULL;
+    for (size_t value = 0; value < range; value++) {
+        if (rng_next() & 1) {
+            array_push(set, (uint32_t)value);
+        }
+    }
+    return set;
+}
+
+static void setup_sets(void *ctx) {
+    Set_Context *context = ctx;
+    rng_reset();
+    context->a = random_set(context->range_a);
+    context->b = random_set(context->range_b);
+}
+
+static void teardown_sets(void *ctx) {
+    Set_Context *context = ctx;
+    array_delete(context->a);
+    array_delete(context->b);
+    array_delete(context->output);
+    context->a = NULL;
+    context->b = NULL;
+    context->output = NULL;
+}
+
+static void bench_sorted_intersect(void *ctx) {
+    Set_Context *context = ctx;
+    array_sorted_intersect(context->output, context->a, context->b, compare_u32);
+    sink += array_size(context->output);
+}
+
+static void bench_sorted_intersect_u32(void *ctx) {
+    Set_Context *context = ctx;
+    array_sorted_intersect_u32(context->output, context->a, context->b);
+    sink += array_size(context->output);
+}
+
+static void bench_sorted_union(void *ctx) {
+    Set_Context *context = ctx;
+    array_sorted_union(context->output, context->a, context->b, compare_u32);
+    sink += array_size(context->output);
+}
+
+// Baseline: looks for each element of b in a with a binary search
+static void bench_binary_search_intersect(void *ctx) {
+    Set_Context *context = ctx;
+    array_clear(context->output);
+    for (size_t i = 0; i < array_size(context->b); i++) {
+        const size_t index = array_binary_search(context->a, &context->b[i], compare_u32);
+        if (array_index_is_valid(context->a, index)) {
+            array_push(context->output, context->b[i]);
+        }
+    }
+    sink += array_size(context->output);
+}
+
+//------------------------------------------------------------------------------
+// B+ tree
+
+typedef struct {
+    size_t count;
+    Btree tree;
+} Btree_Context;
+
+static void setup_btree(void *ctx) {
+    Btree_Context *context = ctx;
+    context->tree = btree_new(size_t, compare_size_t);
+}
+
+static void setup_filled_btree(void *ctx) {
+    Btree_Context *context = ctx;
+    setup_btree(ctx);
+    for (size_t i = 0; i < context->count; i++) {
+        btree_insert(&context->tree, &random_keys[i], NULL);
+    }
+}
+
+static void teardown_btree(void *ctx) {
+    Btree_Context *context = ctx;
+    btree_delete(&context->tree);
+}
+
+static void bench_btree_insert(void *ctx) {
+    Btree_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        btree_insert(&context->tree, &random_keys[i], NULL);
+    }
+    sink += btree_size(&context->tree);
+}
+
+static void bench_btree_get(void *ctx) {
+    Btree_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        sink += (size_t)btree_get(&context->tree, &random_keys[i]);
+    }
+}
+
+static void bench_btree_bulk_load(void *ctx) {
+    Btree_Context *context = ctx;
+    // sorted_keys holds the dataset in ascending order, without duplicates
+    btree_bulk_load(&context->tree, sorted_keys);
+    sink += btree_size(&context->tree);
+}
+
+//------------------------------------------------------------------------------
+// Multi-producer multi-consumer queue
+
+#define QUEUE_MAX_THREADS 16
+#define QUEUE_BATCH_SIZE 32
+
+typedef struct {
+    size_t count;       // Number of elements passed through the queue
+    size_t threads;     // Number of producers, and also of consumers
+    size_t batch;       // Elements per operation
+    Mpmc_Queue *queue;
+    size_t consumed;
+} Queue_Context;
+
+static void setup_queue(void *ctx) {
+    Queue_Context *context = ctx;
+    context->queue = mpmc_queue_new(size_t, 1024);
+    context->consumed = 0;
+}
+
+static void teardown_queue(void *ctx) {
+    Queue_Context *context = ctx;
+    mpmc_queue_delete(context->queue);
+    context->queue = NULL;
+}
+
+// The threads yield when the queue is full or empty, since there may be
+// more threads than processors
+static void *queue_producer(void *ctx) {
+    Queue_Context *context = ctx;
+    size_t elements[QUEUE_BATCH_SIZE] = { 0 };
+    size_t remaining = context->count / context->threads;
+    while (remaining > 0) {
+        const size_t enqueued = mpmc_queue_enqueue_batch(context->queue, elements, INT_MIN(remaining, context->batch));
+        if (enqueued == 0) {
+            sched_yield();
+        }
+        remaining -= enqueued;
+    }
+    return NULL;
+}
+
+static void *queue_consumer(void *ctx) {
+    Queue_Context *context = ctx;
+    const size_t total = (context->count / context->threads) * context->threads;
+    size_t elements[QUEUE_BATCH_SIZE];
+    while (CDATA_ATOMIC_LOAD(&context->consumed) < total) {
+        const size_t dequeued = mpmc_queue_dequeue_batch(context->queue, elements, context->batch);
+        if (dequeued == 0) {
+            sched_yield();
+        } else {
+            CDATA_ATOMIC_FETCH_ADD(&context->consumed, dequeued);
+        }
+    }
+    return NULL;
+}
+
+static void bench_queue_throughput(void *ctx) {
+    Queue_Context *context = ctx;
+    pthread_t threads[2*QUEUE_MAX_THREADS];
+    for (size_t i = 0; i < 2*context->threads; i++) {
+        const int error = pthread_create(&threads[i], NULL, (i % 2 == 0) ? queue_producer : queue_consumer, context);
+        if (error != 0) {
+            // The consumers would wait forever for the elements of a missing producer
+            fprintf(stderr, "Error: Could not create thread: %s\n", strerror(error));
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 0; i < 2*context->threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    sink += context->consumed;
+}
+
+//------------------------------------------------------------------------------
+// Caches
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    Cache_Policy policy;
+    Cache *cache;
+    size_t *accesses;
+} Cache_Context;
+
+// The keys are skewed towards the smallest ones (key = range*u^3, with u uniform in [0, 1))
+static void setup_cache(void *ctx) {
+    Cache_Context *context = ctx;
+    const size_t range = 16*context->capacity;
+    rng_reset();
+    for (size_t i = 0; i < context->count; i++) {
+        const double u = (double)(rng_next() >> 11) / 9007199254740992.0;
+        array_push(context->accesses, (size_t)((double)range*u*u*u));
+    }
+    context->cache = cache_new(size_t, context->capacity, context->policy, hash_size_t, compare_size_t);
+}
+
+static void teardown_cache(void *ctx) {
+    Cache_Context *context = ctx;
+    cache_delete(context->cache);
+    array_delete(context->accesses);
+    context->cache = NULL;
+    context->accesses = NULL;
+}
+
+// Each miss is followed by an insertion, as when the cache is in front of a slower storage
+static void bench_cache_get_or_put(void *ctx) {
+    Cache_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        if (cache_get(context->cache, &context->accesses[i]) == NULL) {
+            cache_put(context->cache, &context->accesses[i], NULL);
+        }
+    }
+    sink += cache_hits(context->cache);
+}
+
+//------------------------------------------------------------------------------
+// Slot map
+
+typedef struct {
+    size_t count;
+    Slot_Map map;
+    Slot_Map_Handle *handles; // In random order
+    size_t *array;
+} Slot_Map_Context;
+
+static void setup_slot_map(void *ctx) {
+    Slot_Map_Context *context = ctx;
+    context->map = slot_map_new(size_t);
+}
+
+static void setup_filled_slot_map(void *ctx) {
+    Slot_Map_Context *context = ctx;
+    setup_slot_map(ctx);
+    for (size_t i = 0; i < context->count; i++) {
+        array_push(context->handles, slot_map_insert(&context->map, &random_keys[i]));
+        array_push(context->array, random_keys[i]);
+    }
+    rng_reset();
+    for (size_t i = context->count - 1; i > 0; i--) {
+        const size_t j = rng_next() % (i + 1);
+        const Slot_Map_Handle handle = context->handles[i];
+        context->handles[i] = context->handles[j];
+        context->handles[j] = handle;
+    }
+}
+
+static void teardown_slot_map(void *ctx) {
+    Slot_Map_Context *context = ctx;
+    slot_map_delete(&context->map);
+    array_delete(context->handles);
+    array_delete(context->array);
+    context->handles = NULL;
+    context->array = NULL;
+}
+
+static void bench_slot_map_insert(void *ctx) {
+    Slot_Map_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        sink += (size_t)slot_map_insert(&context->map, &random_keys[i]);
+    }
+}
+
+static void bench_slot_map_get(void *ctx) {
+    Slot_Map_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        sink += *(size_t *)slot_map_get(&context->map, context->handles[i]);
+    }
+}
+
+static void bench_slot_map_remove(void *ctx) {
+    Slot_Map_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        sink += (size_t)slot_map_remove(&context->map, context->handles[i]);
+    }
+}
+
+// Baseline: removes elements at random positions, shifting the following ones
+static void bench_array_remove_at(void *ctx) {
+    Slot_Map_Context *context = ctx;
+    for (size_t i = 0; i < context->count; i++) {
+        const size_t index = random_keys[i] % array_size(context->array);
+        array_remove_at(context->array, index);
+    }
+    sink += array_size(context->array);
+}
+
+//------------------------------------------------------------------------------
+// Bitsets
+
+typedef struct {
+    size_t bits;
+    uint64_t *a;
+    uint64_t *b;
+    uint64_t *sparse; // Exactly one bit set in each word
+    size_t *rank_index;
+} Bitset_Context;
+
+static void setup_bitsets(void *ctx) {
+    Bitset_Context *context = ctx;
+    rng_reset();
+    bitset_resize(context->a, context->bits);
+    bitset_resize(context->b, context->bits);
+    bitset_resize(context->sparse, context->bits);
+    for (size_t i = 0; i < array_size(context->a); i++) {
+        context->a[i] = (uint64_t)rng_next();
+        context->b[i] = (uint64_t)rng_next();
+        context->sparse[i] = (uint64_t)1 << (rng_next() % BITSET_WORD_BITS);
+    }
+    bitset_rank_build(context->rank_index, context->a);
+}
+
+static void teardown_bitsets(void *ctx) {
+    Bitset_Context *context = ctx;
+    bitset_delete(context->a);
+    bitset_delete(context->b);
+    bitset_delete(context->sparse);
+    array_delete(context->rank_index);
+    context->a = NULL;
+    context->b = NULL;
+    context->sparse = NULL;
+    context->rank_index = NULL;
+}
+
+static void bench_bitset_and(void *ctx) {
+    Bitset_Context *context = ctx;
+    bitset_and(context->a, context->b);
+    sink += context->a[0];
+}
+
+static void bench_bitset_popcount(void *ctx) {
+    Bitset_Context *context = ctx;
+    sink += bitset_popcount(context->a);
+}
+
+static void bench_bitset_find_next(void *ctx) {
+    Bitset_Context *context = ctx;
+    bitset_for_each(context->sparse, index) {
+        sink += index;
+    }
+}
+
+static void bench_bitset_rank_indexed(void *ctx) {
+    Bitset_Context *context = ctx;
+    for (size_t i = 0; i < array_size(random_keys); i++) {
+        sink += bitset_rank_indexed(context->a, context->rank_index, random_keys[i] % context->bits);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Parallel loops
+
+typedef struct {
+    size_t count;
+    size_t threads; // Zero for one thread per processor
+    Thread_Pool *pool;
+    size_t *array;
+    size_t *table;
+} Parallel_Context;
+
+static void setup_parallel(void *ctx) {
+    Parallel_Context *context = ctx;
+    rng_reset();
+    for (size_t i = 0; i < context->count; i++) {
+        array_push(context->array, (size_t)rng_next());
+    }
+    context->table = hash_table_new(size_t, hash_size_t, compare_size_t);
+    for (size_t i = 0; i < array_size(random_keys); i++) {
+        hash_table_insert(context->table, &random_keys[i], NULL);
+    }
+    // Created right before the first loop, whose workers may not be running yet
+    context->pool = thread_pool_new(context->threads);
+    assert(context->pool != NULL);
+}
+
+static void teardown_parallel(void *ctx) {
+    Parallel_Context *context = ctx;
+    thread_pool_delete(context->pool);
+    array_delete(context->array);
+    hash_table_delete(context->table);
+    context->pool = NULL;
+    context->array = NULL;
+    context->table = NULL;
+}
+
+static void sum_range(void *context, void *accumulator, const void *array, size_t begin, size_t end) {
+    (void)context;
+    const size_t *elements = array;
+    size_t sum = *(size_t *)accumulator;
+    for (size_t i = begin; i < end; i++) {
+        sum += elements[i];
+    }
+    *(size_t *)accumulator = sum;
+}
+
+static void sum_combine(void *context, void *accumulator, const void *partial) {
+    (void)context;
+    *(size_t *)accumulator += *(const size_t *)partial;
+}
+
+// Counts the multiples of 1024, so that the threads rarely write to the counter
+static void count_multiples(void *context, void *element) {
+    if ((*(size_t *)element % 1024) == 0) {
+        CDATA_ATOMIC_FETCH_ADD((size_t *)context, (size_t)1);
+    }
+}
+
+static void bench_array_parallel_reduce(void *ctx) {
+    Parallel_Context *context = ctx;
+    size_t sum = 0;
+    array_parallel_reduce(context->pool, context->array, &sum, sum_range, sum_combine, NULL);
+    sink += sum;
+}
+
+static void bench_hash_table_parallel_for_each(void *ctx) {
+    Parallel_Context *context = ctx;
+    size_t multiples = 0;
+    hash_table_parallel_for_each(context->pool, context->table, count_multiples, &multiples);
+    sink += multiples;
+}
+
+//------------------------------------------------------------------------------
+// Harness
+
+static void noop(void *ctx) {
+    (void)ctx;
+}
+
+static double percentile(const double *sorted, size_t count, double p) {
+    size_t index = (size_t)(p*(double)(count - 1) + 0.5);
+    return sorted[INT_MIN(index, count - 1)];
+}
+
+int compare_double(const void *a, const void *b) {
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static Bench_Result bench_run(const Benchmark *bench) {
+    double *ns_per_op = NULL;
+    const Bench_Fcn setup = bench->setup ? bench->setup : noop;
+    const Bench_Fcn teardown = bench->teardown ? bench->teardown : noop;
+    // The first sample is a warmup, and is discarded
+    for (size_t i = 0; i <= samples; i++) {
+        setup(bench->context);
+        const double tic = now_ns();
+        bench->run(bench->context);
+        const double toc = now_ns();
+        teardown(bench->context);
+        if (i > 0) {
+            array_push(ns_per_op, (toc - tic)/(double)bench->ops);
+        }
+    }
+    array_qsort(ns_per_op, compare_double);
+    Bench_Result result = {
+        .min = ns_per_op[0],
+        .p50 = percentile(ns_per_op, array_size(ns_per_op), 0.50),
+        .p90 = percentile(ns_per_op, array_size(ns_per_op), 0.90),
+        .p99 = percentile(ns_per_op, array_size(ns_per_op), 0.99),
+    };
+    array_for_each(ns_per_op, it) {
+        result.mean += *it;
+    }
+    result.mean /= (double)array_size(ns_per_op);
+    array_delete(ns_per_op);
+    return result;
+}
+
+static Baseline *load_baseline(const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Could not open file \"%s\": %s\n", filename, strerror(errno));
+        return NULL;
+    }
+    Baseline *baseline = NULL;
+    char line[512];
+    // Skips the header line
+    if (fgets(line, sizeof(line), file) != NULL) {
+        while (fgets(line, sizeof(line), file) != NULL) {
+            char name[64], params[64];
+            double mean, p50;
+            if (sscanf(line, "%63[^,],%63[^,],%lf,%lf", name, params, &mean, &p50) == 4) {
+                Baseline entry = { .p50 = p50 };
+                snprintf(entry.name, sizeof(entry.name), "%s/%s", name, params);
+                array_push(baseline, entry);
+            }
+        }
+    }
+    fclose(file);
+    return baseline;
+}
+
+static void usage(FILE *const stream, const char *const program_name) {
+    fprintf(stream, "Usage: %s [options]\n", program_name);
+    fprintf(stream, "Options:\n");
+    fprintf(stream, "  -o  <file>               Writes the results as CSV to the specified file\n");
+    fprintf(stream, "  -c  <file>               Compares the results with a CSV file from a previous run\n");
+    fprintf(stream, "  -f  <string>             Only runs the benchmarks whose name contains the string\n");
+    fprintf(stream, "  -s  <unsigned integer>   Number of samples of each benchmark (default: %zu)\n", samples);
+    fprintf(stream, "  -h                       Display this help message\n");
+}
+
+int main(const int argc, const char *const argv[]) {
+    assert(argc > 0);
+    const char *const program_name = argv[0];
+    const char *output_filename = NULL;
+    const char *baseline_filename = NULL;
+    const char *filter = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char *const arg = argv[i];
+        if ((strlen(arg) != 2) || (arg[0] != '-')) {
+            fprintf(stderr, "Error: Unrecognized argument: %s\n", arg);
+            usage(stderr, program_name);
+            return EXIT_FAILURE;
+        }
+        if (arg[1] == 'h') {
+            usage(stdout, program_name);
+            return EXIT_SUCCESS;
+        }
+        if (++i == argc) {
+            fprintf(stderr, "Error: Argument %s should be followed by a value\n", arg);
+            usage(stderr, program_name);
+            return EXIT_FAILURE;
+        }
+        switch (arg[1]) {
+        case 'o': output_filename = argv[i]; break;
+        case 'c': baseline_filename = argv[i]; break;
+        case 'f': filter = argv[i]; break;
+        case 's': samples = strtoul(argv[i], NULL, 10); break;
+        default:
+            fprintf(stderr, "Error: Unrecognized argument: %s\n", arg);
+            usage(stderr, program_name);
+            return EXIT_FAILURE;
+        }
+    }
+    if (samples == 0) {
+        fprintf(stderr, "Error: The number of samples should be greater than zero\n");
+        return EXIT_FAILURE;
+    }
+    Baseline *baseline = NULL;
+    if (baseline_filename != NULL) {
+        baseline = load_baseline(baseline_filename);
+        if (baseline == NULL) {
+            return EXIT_FAILURE;
+        }
+    }
+    FILE *output = NULL;
+    if (output_filename != NULL) {
+        output = fopen(output_filename, "w");
+        if (output == NULL) {
+            fprintf(stderr, "Error: Could not open file \"%s\": %s\n", output_filename, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        fprintf(output, "name,params,mean_ns,p50_ns,p90_ns,p99_ns,min_ns\n");
+    }
+
+    const size_t count = 1000000;
+    datasets_init(count);
+
+    Array_Context push = { .count = count };
+    Array_Context insert_sorted = { .count = 20000 };
+    Array_Context binary_search = { .count = count };
+    Array_Context qsort = { .count = count };
+    Hash_Context hash[] = {
+        { .capacity = 1 << 20, .count = (1 << 20)/10 },
+        { .capacity = 1 << 20, .count = (1 << 20)/4 },
+        { .capacity = 1 << 20, .count = (1 << 20)*45/100 },
+    };
+    Perfect_Hash_Context perfect_hash = { .count = (1 << 20)*45/100 };
+    // The range is twice the size of the sets
+    Set_Context sets = { .range_a = 2*count, .range_b = 2*count };
+    Set_Context skewed_sets = { .range_a = 2*count, .range_b = 2000 };
+    Btree_Context btree_small = { .count = 20000 };
+    Btree_Context btree = { .count = count };
+    Queue_Context queues[] = {
+        { .count = count, .threads = 1, .batch = 1 },
+        { .count = count, .threads = 2, .batch = 1 },
+        { .count = count, .threads = 4, .batch = 1 },
+        { .count = count, .threads = 1, .batch = QUEUE_BATCH_SIZE },
+        { .count = count, .threads = 2, .batch = QUEUE_BATCH_SIZE },
+        { .count = count, .threads = 4, .batch = QUEUE_BATCH_SIZE },
+    };
+    Cache_Context lru_cache = { .count = count, .capacity = 1 << 16, .policy = CACHE_LRU };
+    Cache_Context clock_cache = { .count = count, .capacity = 1 << 16, .policy = CACHE_CLOCK };
+    Slot_Map_Context slot_map_small = { .count = 20000 };
+    Slot_Map_Context slot_map = { .count = count };
+    Bitset_Context bitset = { .bits = 1 << 24 };
+    Parallel_Context serial = { .count = 1 << 24, .threads = 1 };
+    Parallel_Context parallel = { .count = 1 << 24, .threads = 0 };
+    Parallel_Context four_threads = { .count = 1 << 24, .threads = 4 };
+    Arena_Context arena_small = { .count = count, .size = 16 };
+    Arena_Context arena_large = { .count = count/10, .size = 1024 };
+    Arena_Context arena_strings = { .count = count };
+
+    Benchmark *benchmarks = NULL;
+    Benchmark bench;
+    bench = (Benchmark){ "array_push", "size_t,n=1000000", push.count, NULL, bench_array_push, array_context_teardown, &push };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_push", "size_t,3/array,heap", push.count, NULL, bench_array_push_small, array_context_teardown, &push };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_push", "size_t,3/array,stack", push.count, NULL, bench_array_push_small_storage, array_context_teardown, &push };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_insert_sorted", "size_t,n=20000", insert_sorted.count, NULL, bench_array_insert_sorted, array_context_teardown, &insert_sorted };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_binary_search", "size_t,n=1000000", binary_search.count, setup_sorted_array, bench_array_binary_search, array_context_teardown, &binary_search };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_qsort", "size_t,n=1000000", qsort.count, setup_random_array, bench_array_qsort, array_context_teardown, &qsort };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_qsort", "string,n=1000000", qsort.count, setup_random_array, bench_array_qsort_strings, array_context_teardown, &qsort };
+    array_push(benchmarks, bench);
+    static const char *const load_factors[] = { "0.10", "0.25", "0.45" };
+    static char hash_params[4][STATIC_ARRAY_SIZE(load_factors)][64];
+    static const char *const key_types[] = { "size_t", "size_t", "string", "string" };
+    static const char *const hash_names[] = { "hash_table_insert", "hash_table_get", "hash_table_insert", "hash_table_get" };
+    static const Bench_Fcn hash_setups[] = { setup_hash_table, setup_filled_hash_table, setup_hash_table, setup_filled_hash_table };
+    static const Bench_Fcn hash_runs[] = { bench_hash_table_insert, bench_hash_table_get, bench_hash_table_insert_strings, bench_hash_table_get_strings };
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(hash_names); i++) {
+        for (size_t j = 0; j < STATIC_ARRAY_SIZE(hash); j++) {
+            snprintf(hash_params[i][j], sizeof(hash_params[i][j]), "%s,load=%s", key_types[i], load_factors[j]);
+            bench = (Benchmark){ (char *)hash_names[i], hash_params[i][j], hash[j].count, hash_setups[i], hash_runs[i], teardown_hash_table, &hash[j] };
+            array_push(benchmarks, bench);
+        }
+    }
+    bench = (Benchmark){ "perfect_hash_get", "size_t,n=471859", perfect_hash.count, setup_perfect_hash, bench_perfect_hash_get, teardown_perfect_hash, &perfect_hash };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "perfect_hash_build", "size_t,n=471859", perfect_hash.count, NULL, bench_perfect_hash_build, teardown_perfect_hash, &perfect_hash };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_sorted_intersect", "u32,1M&1M", 2*count, setup_sets, bench_sorted_intersect, teardown_sets, &sets };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_sorted_intersect_u32", "1M&1M", 2*count, setup_sets, bench_sorted_intersect_u32, teardown_sets, &sets };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_sorted_union", "u32,1M&1M", 2*count, setup_sets, bench_sorted_union, teardown_sets, &sets };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_sorted_intersect", "u32,1M&1K", 1000, setup_sets, bench_sorted_intersect, teardown_sets, &skewed_sets };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "binary_search_intersect", "u32,1M&1K", 1000, setup_sets, bench_binary_search_intersect, teardown_sets, &skewed_sets };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "btree_insert", "size_t,n=20000", btree_small.count, setup_btree, bench_btree_insert, teardown_btree, &btree_small };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "btree_insert", "size_t,n=1000000", btree.count, setup_btree, bench_btree_insert, teardown_btree, &btree };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "btree_get", "size_t,n=1000000", btree.count, setup_filled_btree, bench_btree_get, teardown_btree, &btree };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "btree_bulk_load", "size_t,n=1000000", btree.count, setup_btree, bench_btree_bulk_load, teardown_btree, &btree };
+    array_push(benchmarks, bench);
+    static char queue_params[STATIC_ARRAY_SIZE(queues)][64];
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(queues); i++) {
+        snprintf(queue_params[i], sizeof(queue_params[i]), "%zup%zuc,batch=%zu", queues[i].threads, queues[i].threads, queues[i].batch);
+        bench = (Benchmark){ "mpmc_queue", queue_params[i], queues[i].count, setup_queue, bench_queue_throughput, teardown_queue, &queues[i] };
+        array_push(benchmarks, bench);
+    }
+    bench = (Benchmark){ "cache_get_or_put", "lru,capacity=65536", lru_cache.count, setup_cache, bench_cache_get_or_put, teardown_cache, &lru_cache };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "cache_get_or_put", "clock,capacity=65536", clock_cache.count, setup_cache, bench_cache_get_or_put, teardown_cache, &clock_cache };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "slot_map_insert", "size_t,n=1000000", slot_map.count, setup_slot_map, bench_slot_map_insert, teardown_slot_map, &slot_map };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "slot_map_get", "size_t,n=1000000", slot_map.count, setup_filled_slot_map, bench_slot_map_get, teardown_slot_map, &slot_map };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "slot_map_remove", "size_t,n=1000000", slot_map.count, setup_filled_slot_map, bench_slot_map_remove, teardown_slot_map, &slot_map };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "slot_map_remove", "size_t,n=20000", slot_map_small.count, setup_filled_slot_map, bench_slot_map_remove, teardown_slot_map, &slot_map_small };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_remove_at", "size_t,n=20000", slot_map_small.count, setup_filled_slot_map, bench_array_remove_at, teardown_slot_map, &slot_map_small };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "bitset_and", "bits=16M", (1 << 24)/BITSET_WORD_BITS, setup_bitsets, bench_bitset_and, teardown_bitsets, &bitset };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "bitset_popcount", "bits=16M", (1 << 24)/BITSET_WORD_BITS, setup_bitsets, bench_bitset_popcount, teardown_bitsets, &bitset };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "bitset_find_next", "bits=16M,density=1/64", (1 << 24)/BITSET_WORD_BITS, setup_bitsets, bench_bitset_find_next, teardown_bitsets, &bitset };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "bitset_rank_indexed", "bits=16M,n=1000000", count, setup_bitsets, bench_bitset_rank_indexed, teardown_bitsets, &bitset };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_parallel_reduce", "n=16M,threads=1", serial.count, setup_parallel, bench_array_parallel_reduce, teardown_parallel, &serial };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_parallel_reduce", "n=16M,threads=all", parallel.count, setup_parallel, bench_array_parallel_reduce, teardown_parallel, &parallel };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "array_parallel_reduce", "n=16M,threads=4", four_threads.count, setup_parallel, bench_array_parallel_reduce, teardown_parallel, &four_threads };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "hash_table_parallel_for_each", "n=1000000,threads=1", count, setup_parallel, bench_hash_table_parallel_for_each, teardown_parallel, &serial };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "hash_table_parallel_for_each", "n=1000000,threads=all", count, setup_parallel, bench_hash_table_parallel_for_each, teardown_parallel, &parallel };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "arena_alloc", "size=16", arena_small.count, NULL, bench_arena_alloc, teardown_arena, &arena_small };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "arena_alloc", "size=1024", arena_large.count, NULL, bench_arena_alloc, teardown_arena, &arena_large };
+    array_push(benchmarks, bench);
+    bench = (Benchmark){ "arena_strdup", "n=1000000", arena_strings.count, NULL, bench_arena_strdup, teardown_arena, &arena_strings };
+    array_push(benchmarks, bench);
+
+    printf("%-28s %-22s %10s %10s %10s %10s", "benchmark", "params", "mean ns/op", "p50", "p90", "p99");
+    printf((baseline != NULL) ? " %10s\n" : "\n", "p50 delta");
+    array_for_each(benchmarks, it) {
+        if ((filter != NULL) && (strstr(it->name, filter) == NULL)) {
+            continue;
+        }
+        // The CSV fields can't contain commas, so they are replaced by semicolons
+        char params[64];
+        snprintf(params, sizeof(params), "%s", it->params);
+        for (char *c = params; *c; c++) {
+            if (*c == ',') {
+                *c = ';';
+            }
+        }
+        Bench_Result result = bench_run(it);
+        printf("%-28s %-22s %10.2f %10.2f %10.2f %10.2f", it->name, it->params, result.mean, result.p50, result.p90, result.p99);
+        if (baseline != NULL) {
+            char name[128];
+            snprintf(name, sizeof(name), "%s/%s", it->name, params);
+            array_for_each(baseline, entry) {
+                if (strcmp(entry->name, name) == 0) {
+                    printf(" %+9.1f%%", 100.0*(result.p50 - entry->p50)/entry->p50);
+                    break;
+                }
+            }
+        }
+        printf("\n");
+        fflush(stdout);
+        if (output != NULL) {
+            fprintf(output, "%s,%s,%.3f,%.3f,%.3f,%.3f,%.3f\n", it->name, params,
+                result.mean, result.p50, result.p90, result.p99, result.min);
+        }
+    }
+
+    array_delete(benchmarks);
+    array_delete(baseline);
+    arena_delete(&arena_small.arena);
+    arena_delete(&arena_large.arena);
+    arena_delete(&arena_strings.arena);
+    datasets_delete();
+    if (output != NULL) {
+        fclose(output);
+    }
+    return EXIT_SUCCESS;
+}
@@ -29,6 +29,7 @@
 #include <stdlib.h> // realloc, free, qsort
 #include <string.h> // memset, memmove, memcpy, strlen
 #endif // CDATA_NO_STDLIB
+#include <stdint.h> // uint32_t
 
 #ifndef __CDATA_HEADER_ONLY_LIBRARY
 #define __CDATA_HEADER_ONLY_LIBRARY
@@ -81,6 +82,15 @@
 #error "The load factor (LOAD_FACTOR_NUMERATOR/LOAD_FACTOR_DENOMINATOR) should be lower than one!"
 #endif
 
+// The sorted set operations switch from a linear merge to galloping search
+// when one array is this many times bigger than the other
+#ifndef ARRAY_GALLOP_RATIO
+#define ARRAY_GALLOP_RATIO          (16)
+#endif
+#if (ARRAY_GALLOP_RATIO <= 0)
+#error "The ARRAY_GALLOP_RATIO should be greater than zero!"
+#endif
+
 // The default is quadratic probing
 #if !defined(QUADRATIC_PROBING) && !defined(LINEAR_PROBING)
 #define QUADRATIC_PROBING
@@ -89,6 +99,75 @@
 #ifndef ARENA_DEFAULT_REGION_CAPACITY
 #define ARENA_DEFAULT_REGION_CAPACITY       4096
 #endif
+// Each new region is GROWTH_FACTOR times bigger than the previous one, up to this limit
+#ifndef ARENA_MAX_REGION_CAPACITY
+#define ARENA_MAX_REGION_CAPACITY           (64*1024*1024)
+#endif
+#if (ARENA_MAX_REGION_CAPACITY < ARENA_DEFAULT_REGION_CAPACITY)
+#error "The ARENA_MAX_REGION_CAPACITY should be greater or equal to ARENA_DEFAULT_REGION_CAPACITY!"
+#endif
+// Alignment used by arena_alloc (should be a power of two)
+#ifndef ARENA_DEFAULT_ALIGNMENT
+#define ARENA_DEFAULT_ALIGNMENT             (sizeof(void *))
+#endif
+
+// Size in bytes of each block allocated by the pool allocator
+#ifndef POOL_DEFAULT_BLOCK_SIZE
+#define POOL_DEFAULT_BLOCK_SIZE             (64*1024)
+#endif
+// Number of objects moved at once between a pool and its thread caches
+#ifndef POOL_CACHE_BATCH
+#define POOL_CACHE_BATCH                    (64)
+#endif
+#if (POOL_CACHE_BATCH <= 0)
+#error "The POOL_CACHE_BATCH should be greater than zero!"
+#endif
+
+#ifndef CDATA_CACHE_LINE_SIZE
+#define CDATA_CACHE_LINE_SIZE               (64)
+#endif
+// Size in bytes of the nodes of the B+ tree (should be a multiple of the cache line size)
+#ifndef BTREE_NODE_SIZE
+#define BTREE_NODE_SIZE                     (4*CDATA_CACHE_LINE_SIZE)
+#endif
+#if (BTREE_NODE_SIZE % CDATA_CACHE_LINE_SIZE != 0)
+#error "The BTREE_NODE_SIZE should be a multiple of CDATA_CACHE_LINE_SIZE!"
+#endif
+// Minimum number of elements of each node of the B+ tree
+#ifndef BTREE_MIN_CAPACITY
+#define BTREE_MIN_CAPACITY                  (4)
+#endif
+#if (BTREE_MIN_CAPACITY < 3)
+#error "The BTREE_MIN_CAPACITY should be at least three!"
+#endif
+// Maximum height of the B+ tree, enough for any number of elements that fits in memory
+#define BTREE_MAX_HEIGHT                    (64)
+
+// Average number of keys in each bucket of the minimal perfect hash. Bigger
+// buckets need less memory (32 bits per bucket), but take longer to build.
+#ifndef PERFECT_HASH_BUCKET_SIZE
+#define PERFECT_HASH_BUCKET_SIZE            (4)
+#endif
+#if (PERFECT_HASH_BUCKET_SIZE <= 0)
+#error "The PERFECT_HASH_BUCKET_SIZE should be greater than zero!"
+#endif
+// Number of seeds tried before the construction of a minimal perfect hash fails
+#ifndef PERFECT_HASH_MAX_ATTEMPTS
+#define PERFECT_HASH_MAX_ATTEMPTS           (16)
+#endif
+
+// Minimum number of elements (or slots, for hash tables) that each thread
+// of a parallel loop processes at once
+#ifndef PARALLEL_MIN_CHUNK
+#define PARALLEL_MIN_CHUNK                  (4096)
+#endif
+#if (PARALLEL_MIN_CHUNK <= 0)
+#error "The PARALLEL_MIN_CHUNK should be greater than zero!"
+#endif
+// Parallel loops over fewer elements than this run only in the calling thread
+#ifndef PARALLEL_SERIAL_THRESHOLD
+#define PARALLEL_SERIAL_THRESHOLD           (8*PARALLEL_MIN_CHUNK)
+#endif
 
 // Custom function modifier
 #ifndef CDATA_FCN_DEF
@@ -165,6 +244,12 @@
 
 #if defined(__GNUC__) || defined(__clang__)
 #define CDATA_TYPEOF_SUPPORTED 
+#define CDATA_ATOMICS_SUPPORTED
+#endif
+
+#if defined(__SSE2__) && !defined(CDATA_NO_SIMD)
+#define CDATA_SSE2_SUPPORTED
+#include <emmintrin.h>
 #endif
 
 //------------------------------------------------------------------------------
@@ -178,6 +263,17 @@
 #define INT_MIN(a,b)                ((a)<(b)?(a):(b))
 #define INT_MAX(a,b)                ((a)>(b)?(a):(b))
 
+// Biggest alignment required by the basic types, which is also given by malloc
+#if defined(__GNUC__) || defined(__clang__)
+#define CDATA_MAX_ALIGNMENT         INT_MAX(__alignof__(long double), sizeof(void *))
+#else
+#define CDATA_MAX_ALIGNMENT         ((size_t)16)
+#endif
+// The alignment of a type divides its size, so the lowest bit set of the size
+// is enough to align any type of that size
+#define CDATA_ALIGNMENT_OF_SIZE(size) \
+    INT_MIN((size_t)(size) & (~(size_t)(size) + 1), CDATA_MAX_ALIGNMENT)
+
 // Bit operations
 #define TEST_BIT(value,bit)         ((value) &  (1L << (bit)))
 #define SET_BIT(value,bit)          ((value) |= (1L << (bit)))
@@ -190,6 +286,107 @@
 #define ERROR(msg)                  _Static_assert(0, (msg))
 #endif
 
+// Atomic operations, used by the containers that may be shared between threads
+#ifdef CDATA_ATOMICS_SUPPORTED
+#define CDATA_ATOMIC_LOAD(ptr)                  __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define CDATA_ATOMIC_STORE(ptr,value)           __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define CDATA_ATOMIC_EXCHANGE(ptr,value)        __atomic_exchange_n((ptr), (value), __ATOMIC_ACQ_REL)
+#define CDATA_ATOMIC_FETCH_ADD(ptr,value)       __atomic_fetch_add((ptr), (value), __ATOMIC_ACQ_REL)
+#define CDATA_ATOMIC_CAS(ptr,expected,desired) \
+    __atomic_compare_exchange_n((ptr), (expected), (desired), 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#if defined(__x86_64__) || defined(__i386__)
+#define CDATA_CPU_RELAX()                       __builtin_ia32_pause()
+#else
+#define CDATA_CPU_RELAX()                       ((void)0)
+#endif
+#else
+#define CDATA_ATOMIC_LOAD(ptr)                  ERROR("Atomic operations are not supported for this compiler!")
+#define CDATA_ATOMIC_STORE(ptr,value)           ERROR("Atomic operations are not supported for this compiler!")
+#define CDATA_ATOMIC_EXCHANGE(ptr,value)        ERROR("Atomic operations are not supported for this compiler!")
+#define CDATA_ATOMIC_FETCH_ADD(ptr,value)       ERROR("Atomic operations are not supported for this compiler!")
+#define CDATA_ATOMIC_CAS(ptr,expected,desired)  ERROR("Atomic operations are not supported for this compiler!")
+#define CDATA_CPU_RELAX()                       ((void)0)
+#endif
+
+// Simple test and test-and-set lock, for very short critical sections
+typedef int Spinlock;
+
+#define spinlock_lock(lock) \
+    do { \
+        while (CDATA_ATOMIC_EXCHANGE((lock), 1)) { \
+            while (CDATA_ATOMIC_LOAD(lock)) { \
+                CDATA_CPU_RELAX(); \
+            } \
+        } \
+    } while (0)
+#define spinlock_unlock(lock)                   CDATA_ATOMIC_STORE((lock), 0)
+
+//------------------------------------------------------------------------------
+// Statistics
+// When CDATA_STATS is defined, the library keeps counters for each kind of
+// container, which may be printed with cdata_stats_dump. Otherwise, all the
+// instrumentation is compiled out. The counters are updated atomically, so
+// the containers may be used by several threads at once, but they should be
+// printed or reset while no other thread uses them.
+
+#ifdef CDATA_STATS
+
+#include <stdio.h> // FILE, fprintf
+#include <time.h>  // clock
+
+// The last bucket of the histogram counts all the longer probe sequences
+#ifndef CDATA_STATS_PROBE_BUCKETS
+#define CDATA_STATS_PROBE_BUCKETS           (16)
+#endif
+
+// The names of the groups don't match the parameters of the macros that count
+// with CDATA_STATS_ADD, otherwise they would be replaced by their arguments
+typedef struct {
+    struct {
+        size_t resizes;
+        size_t bytes_moved; // By memmove, when inserting or removing elements
+    } arrays;
+    struct {
+        size_t lookups;
+        size_t probes;
+        size_t probe_histogram[CDATA_STATS_PROBE_BUCKETS];
+        size_t resizes;
+        size_t resize_clocks;       // Processor time, in units of clock()
+    } hash_tables;
+    struct {
+        size_t regions;
+        size_t region_bytes;
+        size_t allocations;
+        size_t allocated_bytes;
+        size_t wasted_bytes; // Unused tail of the regions left behind
+    } arenas;
+} Cdata_Stats;
+
+extern Cdata_Stats cdata_stats;
+
+#define CDATA_STATS_ADD(counter,value) \
+    ((void)CDATA_ATOMIC_FETCH_ADD(&cdata_stats.counter, (size_t)(value)))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+CDATA_FCN_DEF void cdata_stats_reset(void);
+CDATA_FCN_DEF void cdata_stats_dump(FILE *stream)
+    __attribute__((nonnull));
+
+#ifdef __cplusplus
+}
+#endif
+
+#else // CDATA_STATS
+
+#define CDATA_STATS_ADD(counter,value)      ((void)0)
+#define cdata_stats_reset()                 ((void)0)
+#define cdata_stats_dump(stream)            ((void)(stream))
+
+#endif // CDATA_STATS
+
 // This function type is used for comparing elements in both sorting and search functions.
 // It should return an integer less than zero if the first argument is considered smaller,
 // zero if they are deemed equal, and greater than zero if the first argument is greater
@@ -201,8 +398,14 @@ typedef int (*Compare_Fcn)(const void *, const void *);
 
 #define ARRAY_HEADER_SIZE                       (2*sizeof(size_t))
 
+// The highest bit of the capacity marks the arrays whose storage wasn't
+// allocated by the library (see array_use_storage)
+#define ARRAY_INLINE_STORAGE_FLAG               ((size_t)1 << (sizeof(size_t)*8 - 1))
+
 #define array_size(array)                       ((size_t *)(array))[-1]
-#define array_capacity(array)                   ((size_t *)(array))[-2]
+#define array_capacity(array)                   (_array_capacity_field(array) & ~ARRAY_INLINE_STORAGE_FLAG)
+#define array_has_inline_storage(array)         (((array) != NULL) && ((_array_capacity_field(array) & ARRAY_INLINE_STORAGE_FLAG) != 0))
+#define _array_capacity_field(array)            ((size_t *)(array))[-2]
 
 #define array_clear(array) \
     do { \
@@ -212,11 +415,26 @@ typedef int (*Compare_Fcn)(const void *, const void *);
     } while (0)
 #define array_delete(array) \
     do { \
-        if ((array) != NULL) { \
+        if (((array) != NULL) && !array_has_inline_storage(array)) { \
             CDATA_FREE((void *)((char *)(array) - ARRAY_HEADER_SIZE)); \
         } \
     } while (0)
 
+// Declares a buffer (usually in the stack) able to hold the header of an
+// array and capacity elements of the type
+#define array_storage(type,capacity) \
+    union { \
+        size_t header[2]; \
+        long double align_long_double; \
+        void *align_pointer; \
+        unsigned char bytes[ARRAY_HEADER_SIZE + (capacity)*sizeof(type)]; \
+    }
+// Makes the array use the storage, which should outlive it. Once the array
+// needs more space, its elements are moved to the heap. array_delete only
+// frees the array if it was moved to the heap.
+#define array_use_storage(array,storage) \
+    ((array) = _array_use_storage(&(storage), sizeof(storage), sizeof(*(array))))
+
 #define array_index_is_valid(array,index)       (((array) != NULL) && ((index) < array_size(array)))
 #define array_index_is_invalid(array,index)     (((array) == NULL) || ((index) >= array_size(array)))
 #define array_is_empty(array)                   (((array) == NULL) || (array_size(array) == 0))
@@ -254,6 +472,7 @@ typedef int (*Compare_Fcn)(const void *, const void *);
     do { \
         if (array_is_not_empty(array)) { \
             CDATA_MEMMOVE((array), &array_at((array), 1), (array_size(array) - 1)*sizeof(*(array))); \
+            CDATA_STATS_ADD(arrays.bytes_moved, (array_size(array) - 1)*sizeof(*(array))); \
             array_size(array)--; \
         } \
     } while (0)
@@ -264,6 +483,7 @@ typedef int (*Compare_Fcn)(const void *, const void *);
     CDATA_ASSERT((array) != NULL), \
     array_size(array)++, \
     CDATA_MEMMOVE(&array_at((array) ,1), (array), (array_size(array) - 1)*sizeof(*(array))), \
+    CDATA_STATS_ADD(arrays.bytes_moved, (array_size(array) - 1)*sizeof(*(array))), \
     array_at(array, 0) = (value))
 
 // Insert element at a specified position in the array
@@ -277,6 +497,7 @@ typedef int (*Compare_Fcn)(const void *, const void *);
     do { \
         if (array_index_is_valid((array), (index))) { \
             CDATA_MEMMOVE(&array_at((array), (index)), &array_at((array), (index)+1), (array_size(array) - ((index)+1))*sizeof(*(array))); \
+            CDATA_STATS_ADD(arrays.bytes_moved, (array_size(array) - ((index)+1))*sizeof(*(array))); \
             array_size(array)--; \
         } \
     } while (0)
@@ -298,6 +519,25 @@ typedef int (*Compare_Fcn)(const void *, const void *);
 #define array_insert_sorted(array,value,compare,index) \
     _array_insert_sorted((void **)&(array), sizeof(*(array)), (value), (compare), (index))
 
+// Set operations over arrays sorted in ascending order. The result is written
+// to output, whose previous elements are discarded, and which is resized at
+// most once, to the maximum size of the result. The output shouldn't be one
+// of the inputs. Equal elements are taken from the first array.
+#define array_sorted_union(output,a,b,compare) \
+    ((output) = _array_sorted_union((output), (a), (b), sizeof(*(a)), (compare)))
+#define array_sorted_intersect(output,a,b,compare) \
+    ((output) = _array_sorted_intersect((output), (a), (b), sizeof(*(a)), (compare)))
+// Elements of a that aren't in b
+#define array_sorted_difference(output,a,b,compare) \
+    ((output) = _array_sorted_difference((output), (a), (b), sizeof(*(a)), (compare)))
+// Merges the sorted arrays, keeping the duplicated elements in the order of the arrays.
+// If the memory used to merge them can't be allocated, output is left untouched.
+#define array_sorted_merge(output,arrays,count,compare) \
+    ((output) = _array_sorted_merge((output), (const void *const *)(arrays), (count), sizeof(**(arrays)), (compare)))
+// Intersection of arrays of uint32_t without duplicates, which is vectorized with SSE2
+#define array_sorted_intersect_u32(output,a,b) \
+    ((output) = _array_sorted_intersect_u32((output), (a), (b)))
+
 #define array_address_at(array,index) \
     array_compute_address_at((array),sizeof(*(array)),(index))
 #define array_compute_address_at(array,element_size,index) \
@@ -314,12 +554,32 @@ CDATA_FCN_DEF void *_array_resize(void *array, size_t element_size, size_t heade
     __attribute__((warn_unused_result));
 CDATA_FCN_DEF void *_array_resize_if_needed(void *array, size_t element_size, size_t size_to_add)
     __attribute__((warn_unused_result));
+CDATA_FCN_DEF void *_array_use_storage(void *storage, size_t storage_size, size_t element_size)
+    __attribute__((warn_unused_result, nonnull));
 CDATA_FCN_DEF size_t _array_sequential_search(const void *array, size_t element_size, const void *key, Compare_Fcn compare)
     __attribute__((warn_unused_result, nonnull(3,4)));
 CDATA_FCN_DEF size_t _array_binary_search(const void *array, size_t element_size, const void *key, Compare_Fcn compare)
     __attribute__((warn_unused_result, nonnull(3,4)));
 CDATA_FCN_DEF int _array_insert_sorted(void **array, size_t element_size, const void *element, Compare_Fcn compare, size_t *const user_index)
     __attribute__((nonnull(1,3)));
+CDATA_FCN_DEF size_t _array_gallop(const void *array, size_t size, size_t element_size, const void *key, Compare_Fcn compare, size_t start)
+    __attribute__((warn_unused_result, nonnull(4,5)));
+CDATA_FCN_DEF void *_array_sorted_output(void *output, size_t element_size, size_t max_size)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF void *_array_sorted_union(void *output, const void *a, const void *b, size_t element_size, Compare_Fcn compare)
+    __attribute__((warn_unused_result, nonnull(5)));
+CDATA_FCN_DEF void *_array_sorted_intersect(void *output, const void *a, const void *b, size_t element_size, Compare_Fcn compare)
+    __attribute__((warn_unused_result, nonnull(5)));
+CDATA_FCN_DEF void *_array_sorted_difference(void *output, const void *a, const void *b, size_t element_size, Compare_Fcn compare)
+    __attribute__((warn_unused_result, nonnull(5)));
+CDATA_FCN_DEF void *_array_sorted_merge(void *output, const void *const *arrays, size_t count, size_t element_size, Compare_Fcn compare)
+    __attribute__((warn_unused_result, nonnull(5)));
+CDATA_FCN_DEF uint32_t *_array_sorted_intersect_u32(uint32_t *output, const uint32_t *a, const uint32_t *b)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF int _array_sorted_merge_compare(const void *const *arrays, const size_t *positions, size_t element_size, Compare_Fcn compare, size_t x, size_t y)
+    __attribute__((warn_unused_result, nonnull(1,2,4)));
+CDATA_FCN_DEF int _array_compare_u32(const void *a, const void *b)
+    __attribute__((warn_unused_result, nonnull));
 
 #ifdef __cplusplus
 }
@@ -400,6 +660,8 @@ typedef size_t (*Hash_Fcn)(const void *);
 // This functions shouldn't be called directly, insted use the macros defined above
 CDATA_FCN_DEF size_t djb2(const char *str)
     __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF size_t djb2n(const char *str, size_t length)
+    __attribute__((warn_unused_result, nonnull));
 CDATA_FCN_DEF void *_hash_table_new(size_t element_size, Hash_Fcn hash_function, Compare_Fcn compare_key, size_t initial_capacity)
     __attribute__((warn_unused_result));
 CDATA_FCN_DEF size_t _hash_table_get_index(void *hash_table, size_t element_size, const void *key)
@@ -439,370 +701,4517 @@ typedef struct {
     Region *current;
 } Arena;
 
-// TODO: add arena_snapshot, arena_rewind
+// Position of the arena at some point in time. Rewinding the arena to it frees
+// every allocation done after the snapshot was taken, in O(1).
+typedef struct {
+    Region *region;
+    size_t occupied;
+} Arena_Snapshot;
+
+// Temporary allocation scope, which may be nested
+typedef struct {
+    Arena *arena;
+    Arena_Snapshot snapshot;
+} Arena_Temp;
+
+// Every allocation done inside this block is freed when the block ends.
+// Be carefull: leaving the block with break, goto or return skips the rewind.
+#define arena_scope(arena) \
+    for (Arena_Temp _arena_temp = arena_temp_begin(arena), *_arena_once = &_arena_temp; \
+        _arena_once != NULL; arena_temp_end(_arena_temp), _arena_once = NULL)
 
 CDATA_FCN_DEF void *arena_alloc(Arena *arena, size_t size)
     __attribute__((warn_unused_result, nonnull));
+// The alignment should be a power of two
+CDATA_FCN_DEF void *arena_alloc_aligned(Arena *arena, size_t size, size_t alignment)
+    __attribute__((warn_unused_result, nonnull));
+// Grows (or shrinks) the allocation in place if it was the last one,
+// otherwise a new block is allocated and the contents are copied to it
+CDATA_FCN_DEF void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size)
+    __attribute__((warn_unused_result, nonnull(1)));
 CDATA_FCN_DEF char *arena_strdup(Arena *arena, const char *str)
     __attribute__((warn_unused_result, nonnull));
 CDATA_FCN_DEF char *arena_strndup(Arena *arena, const char *str, size_t len)
     __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void arena_free_all(Arena *arena)
+    __attribute__((nonnull));
+CDATA_FCN_DEF Arena_Snapshot arena_snapshot(const Arena *arena)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void arena_rewind(Arena *arena, Arena_Snapshot snapshot)
+    __attribute__((nonnull));
+CDATA_FCN_DEF Arena_Temp arena_temp_begin(Arena *arena)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void arena_temp_end(Arena_Temp temp);
 CDATA_FCN_DEF void arena_delete(Arena *arena)
     __attribute__((nonnull));
 
+// This functions shouldn't be called directly
+CDATA_FCN_DEF size_t _arena_aligned_offset(const Region *region, size_t alignment)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF int _arena_region_fits(const Region *region, size_t offset, size_t size)
+    __attribute__((warn_unused_result, nonnull));
+
 #ifdef __cplusplus
 }
 #endif
 
-#endif  // __CDATA_HEADER_ONLY_LIBRARY
-
 //------------------------------------------------------------------------------
-// SOURCE
+// Arena allocator shared between threads
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Every thread allocates from its own region, through a Shared_Arena_Local,
+// without any synchronization. The shared lists of regions are only touched
+// when a thread needs a new region, and are updated without locks.
+typedef struct {
+    // Regions given to some thread since the last shared_arena_free_all
+    Region *regions;
+    // Empty regions, recycled by shared_arena_free_all
+    Region *available;
+    size_t generation;
+} Shared_Arena;
+
+// Each thread should have its own Shared_Arena_Local
+typedef struct {
+    Shared_Arena *shared;
+    Region *current;
+    size_t generation;
+} Shared_Arena_Local;
+
+CDATA_FCN_DEF Shared_Arena_Local shared_arena_local(Shared_Arena *shared)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void *shared_arena_alloc(Shared_Arena_Local *local, size_t size)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void *shared_arena_alloc_aligned(Shared_Arena_Local *local, size_t size, size_t alignment)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF char *shared_arena_strdup(Shared_Arena_Local *local, const char *str)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF char *shared_arena_strndup(Shared_Arena_Local *local, const char *str, size_t len)
+    __attribute__((warn_unused_result, nonnull));
+// The following functions should only be called while no thread is allocating
+CDATA_FCN_DEF void shared_arena_free_all(Shared_Arena *shared)
+    __attribute__((nonnull));
+CDATA_FCN_DEF void shared_arena_delete(Shared_Arena *shared)
+    __attribute__((nonnull));
+
+// This functions shouldn't be called directly
+CDATA_FCN_DEF void _shared_arena_push_region(Region **list, Region *region)
+    __attribute__((nonnull));
+CDATA_FCN_DEF Region *_shared_arena_pop_region(Region **list)
+    __attribute__((warn_unused_result, nonnull));
+
+#ifdef __cplusplus
+}
+#endif
+
 //------------------------------------------------------------------------------
+// Pool allocator for objects of fixed size
 
-#ifdef CDATA_IMPLEMENTATION
+#define pool_new(type) \
+    _pool_new(sizeof(type), POOL_DEFAULT_BLOCK_SIZE)
+#define pool_new_with_block_size(type,block_size) \
+    _pool_new(sizeof(type), (block_size))
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Function stolen from https://handwiki.org/wiki/Quadratic_probing
-CDATA_FCN_DEF size_t round_up_2(size_t value) {
-    value--;
-    value |= value >> 1;
-    value |= value >> 2;
-    value |= value >> 4;
-    value |= value >> 8;
-    value |= value >> 16;
-    value |= value >> 32;
-    value++;
-    return value;
-}
+struct _Pool_Block;
+typedef struct _Pool_Block {
+    struct _Pool_Block *next;
+    // Keeps the objects aligned as if they were allocated by malloc
+    union {
+        void *pointer;
+        long double floating_point;
+        long long integer;
+    } data[];
+} Pool_Block;
 
-CDATA_FCN_DEF void *_array_resize(void *array, size_t element_size, size_t header_size, size_t new_capacity) {
-    void *new_p = NULL;
-    if (array == NULL) {
-        new_p = CDATA_REALLOC(NULL, new_capacity * element_size + header_size);
-        CDATA_MEMSET(new_p, 0, header_size);
-        if (new_p == NULL) {
-            return(NULL);
-        }
-    } else {
-        void *p = (void *)((size_t)array - header_size);
-        new_p = CDATA_REALLOC(p, new_capacity * element_size + header_size);
-        if (new_p == NULL) {
-            CDATA_FREE(p);
-            return(NULL);
-        }
-    }
-    void *new_array = (char *)new_p + header_size;
-    void *address = array_compute_address_at(new_array, element_size, array_capacity(new_array));
-    size_t length = (new_capacity - array_capacity(new_array));
-    CDATA_MEMSET(address, 0, length * element_size);
-    array_capacity(new_array) = new_capacity;
-    return(new_array);
-}
+// The freed objects are kept in a intrusive linked list, so every object has
+// at least the size of a pointer
+typedef struct {
+    size_t object_size;
+    size_t objects_per_block;
+    Pool_Block *first;
+    Pool_Block *current;
+    size_t used_in_current;
+    void *free_list;
+    // Only used when the pool is shared between thread caches
+    Spinlock lock;
+} Pool;
 
-CDATA_FCN_DEF void *_array_resize_if_needed(void *array, size_t element_size, size_t size_to_add) {
-    if (array == NULL) {
-        size_t new_capacity = INT_MAX(size_to_add, ARRAY_DEFAULT_CAPACITY);
-        new_capacity = round_up_2(new_capacity);
-        array = _array_resize(NULL, element_size, ARRAY_HEADER_SIZE, new_capacity);
-        if (array == NULL) {
-            return NULL;
-        }
-    }
-    size_t new_size = array_size(array) + size_to_add;
-    if (new_size >= array_capacity(array)) {
-        size_t new_capacity = array_capacity(array);
-        while (new_size >= new_capacity) {
-            new_capacity *= GROWTH_FACTOR;
-        }
-        new_capacity = round_up_2(new_capacity);
-        array = _array_resize(array, element_size, ARRAY_HEADER_SIZE, new_capacity);
-    }
-    return array;
-}
+// Each thread may keep its own cache of free objects, so that it only needs to
+// lock the pool to move a batch of POOL_CACHE_BATCH objects from or to it.
+// When using thread caches, the pool should only be accessed through them.
+typedef struct {
+    Pool *pool;
+    void *free_list;
+    size_t count;
+} Pool_Cache;
 
-CDATA_FCN_DEF void *_array_insert_zero_at(void *array, size_t element_size, size_t index) {
-    size_t old_size = (array == NULL) ? 0 : array_size(array);
-    size_t size_to_add = array_index_is_valid(array, index) ? 1 : ((index) + 1 - old_size);
-    array = _array_resize_if_needed(array, element_size, size_to_add);
-    if (array != NULL) {
-        void *actual = array_compute_address_at(array, element_size, index);
-        if (index < old_size) {
-            void *next = array_compute_address_at(array, element_size, (index+1));
-            size_t length = old_size - index;
-            CDATA_MEMMOVE(next, actual, length*element_size);
-        }
-        CDATA_MEMSET(actual, 0, element_size);
-        array_size(array) = old_size + size_to_add;
-    }
-    return(array);
-}
+CDATA_FCN_DEF Pool _pool_new(size_t object_size, size_t block_size)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF void *pool_alloc(Pool *pool)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void pool_free(Pool *pool, void *ptr)
+    __attribute__((nonnull(1)));
+CDATA_FCN_DEF void pool_free_all(Pool *pool)
+    __attribute__((nonnull));
+CDATA_FCN_DEF void pool_delete(Pool *pool)
+    __attribute__((nonnull));
+CDATA_FCN_DEF Pool_Cache pool_cache_new(Pool *pool)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void *pool_cache_alloc(Pool_Cache *cache)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void pool_cache_free(Pool_Cache *cache, void *ptr)
+    __attribute__((nonnull(1)));
+// Gives all the objects in the cache back to the pool
+CDATA_FCN_DEF void pool_cache_flush(Pool_Cache *cache)
+    __attribute__((nonnull));
 
-// This function returns an invalid index in case the key wasn't found
-CDATA_FCN_DEF size_t _array_sequential_search(const void *array, size_t element_size, const void *key, Compare_Fcn compare) {
-    if (array != NULL) {
-        for (size_t i = 0; i < array_size(array); i++) {
-            const void *it = array_compute_address_at(array, element_size, i);
-            if (!compare(key, it)) {
-                return(i);
-            }
-        }
-    }
-    return((size_t)-1);
+#ifdef __cplusplus
 }
+#endif
 
-// This function returns an invalid index in case the key wasn't found
-CDATA_FCN_DEF size_t _array_binary_search(const void *array, size_t element_size, const void *key, Compare_Fcn compare) {
-    if (array == NULL) {
-        return((size_t)-1);
-    }
-    size_t index;
-    size_t low = 0;
-    size_t high = array_size(array) - 1;
-    while ((low <= high) && array_index_is_valid(array, high)) {
-        index = low + (high - low) / 2; // middle
-        const void *it = array_compute_address_at(array, element_size, index);
-        const int comp = compare(key, it);
-        if (comp < 0) {
-            high = index - 1;
-        } else if (comp > 0) {
-            low = index + 1;
-        } else {
-            return(index);
-        }
-    }
-    // Didn't found the key
-    // Return an invalid index, but with enought information so that _array_insert_sorted
-    // can recover the ideal position for the element to be inserted
-    index = (size_t)-1*(low+1);
-    return(index);
+//------------------------------------------------------------------------------
+// Heavy hitters (Space-Saving algorithm)
+// Keeps approximate counts of the most frequent elements of a stream, using a
+// fixed number of counters. With k counters, after N insertions:
+//  - every element that appeared more than N/k times is being tracked;
+//  - the count of each tracked element is overestimated by at most its error,
+//    which is never greater than N/k.
+// The tracked elements are kept in a min-heap by count, so that the least
+// frequent one can be replaced in O(log k), and in an open addressing index
+// (with linear probing) for the lookups.
+
+#define heavy_hitters_new(type,hash_function,compare_key,capacity) \
+    _heavy_hitters_new(sizeof(type), (hash_function), (compare_key), (capacity))
+// Chooses the number of counters so that the error is at most epsilon*N
+#define heavy_hitters_new_with_error(type,hash_function,compare_key,epsilon) \
+    heavy_hitters_new(type, (hash_function), (compare_key), (size_t)(1.0/(epsilon) + 0.999999))
+#define heavy_hitters_delete(heavy_hitters)     CDATA_FREE(heavy_hitters)
+
+#define heavy_hitters_size(heavy_hitters)       ((heavy_hitters)->size)
+#define heavy_hitters_capacity(heavy_hitters)   ((heavy_hitters)->capacity)
+#define heavy_hitters_total(heavy_hitters)      ((heavy_hitters)->total)
+
+// Access to the tracked elements, with index in [0, heavy_hitters_size)
+#define heavy_hitters_element_at(heavy_hitters,index) \
+    ((void *)((heavy_hitters)->elements + (index)*(heavy_hitters)->element_size))
+#define heavy_hitters_count_at(heavy_hitters,index)     ((heavy_hitters)->counts[(index)])
+#define heavy_hitters_error_at(heavy_hitters,index)     ((heavy_hitters)->errors[(index)])
+#define heavy_hitters_index_of(heavy_hitters,address) \
+    (((size_t)(address) - (size_t)(heavy_hitters)->elements) / (heavy_hitters)->element_size)
+
+// Maximum overestimation of any count (the smallest count being tracked)
+#define heavy_hitters_max_error(heavy_hitters) \
+    (((heavy_hitters)->size < (heavy_hitters)->capacity) ? 0 : (heavy_hitters)->counts[(heavy_hitters)->heap[0]])
+
+#define heavy_hitters_add(heavy_hitters,value,address) \
+    _heavy_hitters_add((heavy_hitters), (value), 1, (void **const)(address))
+#define heavy_hitters_add_count(heavy_hitters,value,count,address) \
+    _heavy_hitters_add((heavy_hitters), (value), (count), (void **const)(address))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    size_t element_size;
+    size_t capacity;
+    size_t size;
+    size_t total;
+    Hash_Fcn hash_function;
+    Compare_Fcn compare_key;
+    size_t *counts;
+    size_t *errors;
+    size_t *hashes;
+    size_t *heap;           // Indexes of the elements, ordered by count
+    size_t *heap_position;  // Position of each element in the heap
+    size_t *index;          // Open addressing table with (element index + 1), or 0 if empty
+    size_t index_capacity;  // Power of two
+    char *elements;
+} Heavy_Hitters;
+
+CDATA_FCN_DEF Heavy_Hitters *_heavy_hitters_new(size_t element_size, Hash_Fcn hash_function, Compare_Fcn compare_key, size_t capacity)
+    __attribute__((warn_unused_result));
+// Returns 1 if the value wasn't being tracked (it was inserted, possibly replacing
+// the least frequent element), and 0 if its count was just incremented. The
+// address of the stored element is returned through user_address.
+CDATA_FCN_DEF int _heavy_hitters_add(Heavy_Hitters *heavy_hitters, const void *value, size_t count, void **const user_address)
+    __attribute__((nonnull(1,2)));
+// Returns the estimated count of the value (zero if it is not being tracked)
+CDATA_FCN_DEF size_t heavy_hitters_count(const Heavy_Hitters *heavy_hitters, const void *value)
+    __attribute__((warn_unused_result, nonnull));
+// Returns a dynamic array with the indexes of the tracked elements, sorted by descending count
+CDATA_FCN_DEF size_t *heavy_hitters_sorted_indexes(const Heavy_Hitters *heavy_hitters)
+    __attribute__((warn_unused_result, nonnull));
+
+// This functions shouldn't be called directly
+CDATA_FCN_DEF size_t _heavy_hitters_find(const Heavy_Hitters *heavy_hitters, const void *value, size_t hash)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void _heavy_hitters_sift_up(Heavy_Hitters *heavy_hitters, size_t position)
+    __attribute__((nonnull));
+CDATA_FCN_DEF void _heavy_hitters_sift_down(Heavy_Hitters *heavy_hitters, size_t position)
+    __attribute__((nonnull));
+CDATA_FCN_DEF void _heavy_hitters_remove_from_index(Heavy_Hitters *heavy_hitters, size_t position)
+    __attribute__((nonnull));
+
+#ifdef __cplusplus
 }
+#endif
 
-// This function returns 1 if a new element was inserted, and 0 if that element is already in the array
+//------------------------------------------------------------------------------
+// Radix tree
+// Adaptive radix tree (ART) which maps byte string keys to values of a fixed
+// size. Each inner node uses the smallest representation (4, 16, 48 or 256
+// children) able to hold its children, and the paths without branches are
+// compressed into a prefix, so that shared prefixes are stored only once.
+// The nodes and leaves are allocated from an arena, and are released with it.
+// The leaves store a copy of the key, followed by a null terminator.
+
+#define radix_tree_new(type,arena)              _radix_tree_new(sizeof(type), (arena))
+#define radix_tree_size(tree)                   ((tree)->size)
+
+#define radix_tree_insert(tree,key,length,address) \
+    _radix_tree_insert((tree), (key), (length), (void **const)(address))
+#define radix_tree_insert_string(tree,key,address) \
+    radix_tree_insert((tree), (key), CDATA_STRLEN(key), (address))
+#define radix_tree_get_string(tree,key) \
+    radix_tree_get((tree), (key), CDATA_STRLEN(key))
+
+// Visits every element in the lexicographic order of the keys
+#define radix_tree_for_each(tree,fcn,context) \
+    radix_tree_for_each_prefix((tree), "", 0, (fcn), (context))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RADIX_NODE4,
+    RADIX_NODE16,
+    RADIX_NODE48,
+    RADIX_NODE256,
+} Radix_Node_Type;
+
+typedef struct {
+    size_t key_length;
+    // Followed by the value and by the key
+} Radix_Leaf;
+
+typedef struct {
+    const unsigned char *prefix;    // Points to the key of some leaf below this node
+    size_t prefix_length;
+    Radix_Leaf *leaf;               // Leaf whose key ends at this node
+    unsigned short count;
+    unsigned char type;
+} Radix_Node;
+
+// The children are tagged pointers, with the lowest bit set for leaves
+typedef struct {
+    Radix_Node node;
+    unsigned char keys[4];          // Sorted
+    void *children[4];
+} Radix_Node4;
+
+typedef struct {
+    Radix_Node node;
+    unsigned char keys[16];         // Sorted
+    void *children[16];
+} Radix_Node16;
+
+typedef struct {
+    Radix_Node node;
+    unsigned char index[256];       // Position in children plus one, or zero if empty
+    void *children[48];
+} Radix_Node48;
+
+typedef struct {
+    Radix_Node node;
+    void *children[256];
+} Radix_Node256;
+
+typedef struct {
+    Arena *arena;
+    size_t value_size;
+    size_t size;
+    void *root;
+    Radix_Node *free_nodes[RADIX_NODE256];  // Nodes replaced by bigger ones, to be reused
+} Radix_Tree;
+
+// Function called for each visited element. If it returns a value different
+// from zero, the iteration stops and that value is returned.
+typedef int (*Radix_Tree_Fcn)(void *context, const char *key, size_t length, void *value);
+
+CDATA_FCN_DEF Radix_Tree _radix_tree_new(size_t value_size, Arena *arena)
+    __attribute__((warn_unused_result, nonnull));
+// Returns 1 if the key was inserted, with its value filled with zeros, 0 if it
+// was already present, and -1 if the allocation failed. The address of the
+// value is returned through user_address.
+CDATA_FCN_DEF int _radix_tree_insert(Radix_Tree *tree, const char *key, size_t length, void **const user_address)
+    __attribute__((nonnull(1,2)));
+// Returns the address of the value of the key, or NULL if it isn't present
+CDATA_FCN_DEF void *radix_tree_get(const Radix_Tree *tree, const char *key, size_t length)
+    __attribute__((warn_unused_result, nonnull));
+// Visits, in lexicographic order, every element whose key starts with prefix
+CDATA_FCN_DEF int radix_tree_for_each_prefix(const Radix_Tree *tree, const char *prefix, size_t length, Radix_Tree_Fcn fcn, void *context)
+    __attribute__((nonnull(1,2,4)));
+
+// This functions shouldn't be called directly
+CDATA_FCN_DEF size_t _radix_tree_mismatch(const unsigned char *a, const unsigned char *b, size_t length)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF Radix_Leaf *_radix_tree_new_leaf(Radix_Tree *tree, const unsigned char *key, size_t length)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF Radix_Node *_radix_tree_new_node(Radix_Tree *tree, Radix_Node_Type type)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void **_radix_tree_find_child(Radix_Node *node, unsigned char byte)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF int _radix_tree_add_child(Radix_Tree *tree, void **reference, unsigned char byte, void *child)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF int _radix_tree_visit(const Radix_Tree *tree, const void *child, Radix_Tree_Fcn fcn, void *context)
+    __attribute__((nonnull(1,3)));
+
+#ifdef __cplusplus
+}
+#endif
+
+//------------------------------------------------------------------------------
+// B+ tree
+// Ordered map of fixed size elements, compared with a Compare_Fcn, with
+// O(log n) insertion, removal and lookups. The elements are stored in the
+// leaves, which are linked in order for the range iterations, while the
+// inner nodes only keep copies of the separator elements. Every node has
+// the same size, a multiple of the cache line size, and is aligned to a
+// cache line. The nodes are allocated from an arena owned by the tree, and
+// the removed ones are reused by the next insertions.
+
+#define btree_new(type,compare)                 _btree_new(sizeof(type), (compare))
+#define btree_size(tree)                        ((tree)->size)
+#define btree_is_empty(tree)                    ((tree)->size == 0)
+
+#define btree_insert(tree,value,address) \
+    _btree_insert((tree), (value), (void **const)(address))
+// Builds the tree from a dynamic array sorted in ascending order, without
+// duplicates. The tree should be empty.
+#define btree_bulk_load(tree,array) \
+    (CDATA_ASSERT(sizeof(*(array)) == (tree)->element_size), \
+    _btree_bulk_load((tree), (array), array_is_empty(array) ? 0 : array_size(array)))
+
+// Iterators are invalidated by insertions and removals
+#define btree_iterator_is_valid(it)             ((it).node != NULL)
+#define btree_iterator_get(tree,it)             ((void *)_btree_element_at((tree), (it).node, (it).index))
+#define btree_iterator_next(it)                 _btree_iterator_next(&(it))
+
+#define btree_for_each(tree,it) \
+    for (Btree_Iterator (it) = btree_begin(tree); btree_iterator_is_valid(it); btree_iterator_next(it))
+// Iterates over the elements in the range [low, high)
+#define btree_for_range(tree,it,low,high) \
+    for (Btree_Iterator (it) = btree_lower_bound((tree), (low)); \
+        btree_iterator_is_valid(it) && ((tree)->compare(btree_iterator_get((tree), (it)), (high)) < 0); \
+        btree_iterator_next(it))
+
+#define _btree_element_at(tree,node,index) \
+    ((char *)(node) + sizeof(Btree_Node) + (index)*(tree)->element_size)
+#define _btree_children(node) \
+    ((Btree_Node **)((char *)(node) + sizeof(Btree_Node)))
+#define _btree_key_at(tree,node,index) \
+    ((char *)(node) + sizeof(Btree_Node) + ((tree)->inner_capacity + 1)*sizeof(Btree_Node *) + (index)*(tree)->element_size)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The leaves are followed by their elements, and the inner nodes by their
+// children and then by their keys (the smallest element of each child but
+// the first)
+typedef struct _Btree_Node {
+    size_t count;                   // Number of elements, or of keys for the inner nodes
+    struct _Btree_Node *next;       // Next leaf
+} Btree_Node;
+
+typedef struct {
+    size_t element_size;
+    Compare_Fcn compare;
+    size_t size;
+    size_t height;                  // Zero for an empty tree, and one if the root is a leaf
+    size_t node_size;
+    size_t leaf_capacity;
+    size_t inner_capacity;
+    Btree_Node *root;
+    Btree_Node *first;              // First leaf
+    Btree_Node *free_nodes;
+    char *scratch;                  // Room for two elements, used to split the inner nodes
+    Arena arena;
+} Btree;
+
+typedef struct {
+    Btree_Node *node;               // Leaf, or NULL at the end of the iteration
+    size_t index;
+} Btree_Iterator;
+
+CDATA_FCN_DEF Btree _btree_new(size_t element_size, Compare_Fcn compare)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void btree_delete(Btree *tree)
+    __attribute__((nonnull));
+// Returns 1 if the value was inserted, 0 if an equal element was already
+// present, and -1 if the allocation failed. The address of the stored element
+// is returned through user_address.
+CDATA_FCN_DEF int _btree_insert(Btree *tree, const void *value, void **const user_address)
+    __attribute__((nonnull(1,2)));
+// Returns 1 if the element equal to key was removed, and 0 if it wasn't found
+CDATA_FCN_DEF int btree_remove(Btree *tree, const void *key)
+    __attribute__((nonnull));
+// Returns the address of the element equal to key, or NULL if it isn't present
+CDATA_FCN_DEF void *btree_get(const Btree *tree, const void *key)
+    __attribute__((warn_unused_result, nonnull));
+// Iterator to the first element, in ascending order
+CDATA_FCN_DEF Btree_Iterator btree_begin(const Btree *tree)
+    __attribute__((warn_unused_result, nonnull));
+// Iterator to the first element not less than key
+CDATA_FCN_DEF Btree_Iterator btree_lower_bound(const Btree *tree, const void *key)
+    __attribute__((warn_unused_result, nonnull));
+
+// This functions shouldn't be called directly
+CDATA_FCN_DEF void _btree_iterator_next(Btree_Iterator *it)
+    __attribute__((nonnull));
+CDATA_FCN_DEF int _btree_bulk_load(Btree *tree, const void *data, size_t count)
+    __attribute__((nonnull(1)));
+CDATA_FCN_DEF size_t _btree_search(const Btree *tree, const char *elements, size_t count, const void *key, int *found)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF Btree_Node *_btree_new_node(Btree *tree)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF int _btree_reserve(Btree *tree, size_t number_of_nodes)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void _btree_insert_key(Btree *tree, Btree_Node *node, size_t position, const void *key, Btree_Node *child)
+    __attribute__((nonnull));
+CDATA_FCN_DEF void _btree_rebalance(Btree *tree, Btree_Node *parent, size_t position, int is_leaf)
+    __attribute__((nonnull));
+
+#ifdef __cplusplus
+}
+#endif
+
+//------------------------------------------------------------------------------
+// String interner
+// Maps each distinct string to a dense 32 bits symbol (0, 1, 2, ...), so that
+// other containers may use the symbols as keys instead of the strings. The
+// strings are copied to an arena, and their hashes are computed only once.
+// Finding the string of a symbol is just an array access.
+
+#define SYMBOL_INVALID                          ((Symbol)-1)
+
+#define interner_intern_string(interner,str) \
+    interner_intern((interner), (str), CDATA_STRLEN(str))
+#define interner_lookup_string(interner,str) \
+    interner_lookup((interner), (str), CDATA_STRLEN(str))
+
+// Number of symbols
+#define interner_size(interner) \
+    (array_is_empty((interner)->strings) ? 0 : array_size((interner)->strings))
+// Null terminated string of the symbol
+#define interner_string(interner,symbol)       ((interner)->strings[(symbol)].string)
+#define interner_length(interner,symbol)       ((interner)->strings[(symbol)].length)
+#define interner_hash(interner,symbol)         ((interner)->strings[(symbol)].hash)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t Symbol;
+
+typedef struct {
+    const char *string;
+    size_t length;
+    size_t hash;
+} Interner_String;
+
+// Element of the hash table, which holds the precomputed hash of the string,
+// so that the table is resized without hashing the strings again
+typedef struct {
+    size_t hash;
+    const char *string;
+    size_t length;
+    Symbol symbol;
+} Interner_Entry;
+
+// It may be zero initialized
+typedef struct {
+    Arena arena;
+    Interner_Entry *table;          // Hash table
+    Interner_String *strings;       // Dynamic array indexed by the symbols
+} Interner;
+
+// Returns the symbol of the string, which is added to the interner if it isn't
+// present yet, or SYMBOL_INVALID if the allocation failed
+CDATA_FCN_DEF Symbol interner_intern(Interner *interner, const char *str, size_t length)
+    __attribute__((warn_unused_result, nonnull));
+// Returns the symbol of the string, or SYMBOL_INVALID if it isn't present
+CDATA_FCN_DEF Symbol interner_lookup(const Interner *interner, const char *str, size_t length)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void interner_delete(Interner *interner)
+    __attribute__((nonnull));
+
+// This functions shouldn't be called directly
+CDATA_FCN_DEF size_t _interner_entry_hash(const void *entry)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF int _interner_entry_compare(const void *a, const void *b)
+    __attribute__((warn_unused_result, nonnull));
+
+#ifdef __cplusplus
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Minimal perfect hash
+// Static set of elements built once (from a dynamic array or a hash table),
+// with exactly one slot for each element and no empty slots. The keys are
+// spread among buckets (PERFECT_HASH_BUCKET_SIZE keys on average), and a
+// "pilot" is searched for each bucket, so that hash(key) XOR mix(pilot)
+// sends every key of the bucket to a free slot. Each lookup computes the
+// slot from the pilot of its bucket, and compares the key with the element
+// stored there, so it probes a single slot.
+// The structure is stored in a single block of memory, which may be written
+// to a file and used again without rebuilding it (see perfect_hash_load).
+
+#define perfect_hash_from_array(perfect_hash,array,hash_function,compare_key) \
+    _perfect_hash_build((perfect_hash), (array), sizeof(*(array)), \
+        (array_is_empty(array) ? 0 : array_size(array)), (hash_function), (compare_key))
+#define perfect_hash_from_hash_table(perfect_hash,hash_table) \
+    _perfect_hash_from_hash_table((perfect_hash), (hash_table), sizeof(*(hash_table)))
+// Uses previously serialized data of elements of the specified type, without
+// copying it, so it should be kept valid (and aligned to 8 bytes) while the
+// structure is used. Returns 0 on success, and -1 if the data is invalid.
+#define perfect_hash_load(perfect_hash,type,data,data_size,hash_function,compare_key) \
+    _perfect_hash_load((perfect_hash), sizeof(type), (data), (data_size), (hash_function), (compare_key))
+
+#define perfect_hash_size(perfect_hash)         ((size_t)(perfect_hash)->header->size)
+#define perfect_hash_element_at(perfect_hash,index) \
+    ((void *)((perfect_hash)->elements + (index)*(perfect_hash)->header->element_size))
+
+// Serialized representation of the structure
+#define perfect_hash_data(perfect_hash)         ((const void *)(perfect_hash)->header)
+#define perfect_hash_data_size(perfect_hash)    _perfect_hash_data_size((perfect_hash)->header)
+
+#define PERFECT_HASH_MAGIC                      ((uint64_t)0x4844415441504843ULL)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Beginning of the serialized data, which is followed by the pilots of the
+// buckets and by the elements, in the native byte order
+typedef struct {
+    uint64_t magic;
+    uint64_t element_size;
+    uint64_t size;
+    uint64_t buckets;
+    uint64_t seed;
+} Perfect_Hash_Header;
+
+typedef struct {
+    Hash_Fcn hash_function;
+    Compare_Fcn compare_key;
+    const Perfect_Hash_Header *header;
+    const uint32_t *pilots;
+    const char *elements;
+    void *owned_data;               // Freed by perfect_hash_delete, or NULL if the data was loaded
+} Perfect_Hash;
+
+// The hash function should give the same results for the same keys, across
+// executions, for the serialized data to be valid. Returns 0 on success, -1
+// if the allocation failed, -2 if there are duplicated keys, and -3 if
+// different keys have the same hash, so that they can't be told apart.
+CDATA_FCN_DEF int _perfect_hash_build(Perfect_Hash *perfect_hash, const void *elements, size_t element_size, size_t count, Hash_Fcn hash_function, Compare_Fcn compare_key)
+    __attribute__((warn_unused_result, nonnull(1,5,6)));
+CDATA_FCN_DEF int _perfect_hash_from_hash_table(Perfect_Hash *perfect_hash, void *hash_table, size_t element_size)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF int _perfect_hash_load(Perfect_Hash *perfect_hash, size_t element_size, const void *data, size_t data_size, Hash_Fcn hash_function, Compare_Fcn compare_key)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void perfect_hash_delete(Perfect_Hash *perfect_hash)
+    __attribute__((nonnull));
+// Returns the slot of the key, in [0, perfect_hash_size). If the key isn't in
+// the set, the slot holds some other element.
+CDATA_FCN_DEF size_t perfect_hash_index(const Perfect_Hash *perfect_hash, const void *key)
+    __attribute__((warn_unused_result, nonnull));
+// Returns the address of the element equal to key, or NULL if it isn't present
+CDATA_FCN_DEF void *perfect_hash_get(const Perfect_Hash *perfect_hash, const void *key)
+    __attribute__((warn_unused_result, nonnull));
+
+// This functions shouldn't be called directly
+CDATA_FCN_DEF uint64_t _perfect_hash_mix(uint64_t x)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF size_t _perfect_hash_data_size(const Perfect_Hash_Header *header)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF int _perfect_hash_search_pilots(uint32_t *pilots, size_t *slots, const uint64_t *hashes, const size_t *keys, const size_t *bucket_start, const size_t *bucket_order, size_t buckets, size_t size, uint64_t seed, uint64_t *taken)
+    __attribute__((warn_unused_result, nonnull));
+
+#ifdef __cplusplus
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Bitset
+// Growable set of bits, stored in a dynamic array of 64 bits words. The number
+// of bits is kept in a hidden header, before the header of the array, and the
+// bits after it are always zero. A NULL bitset is an empty one.
+// The operations between bitsets work on whole words (two words at a time
+// with SSE2), and rank queries may use an index with the cumulative counts of
+// each block of BITSET_RANK_BLOCK_WORDS words.
+
+#define BITSET_WORD_BITS                        (64)
+#define BITSET_HEADER_SIZE                      (ARRAY_HEADER_SIZE + sizeof(size_t))
+// A block of the rank index takes a cache line
+#define BITSET_RANK_BLOCK_WORDS                 (CDATA_CACHE_LINE_SIZE/sizeof(uint64_t))
+
+// Number of bits (the number of words is given by array_size)
+#define bitset_size(bitset)                     ((size_t *)(bitset))[-3]
+
+#define bitset_delete(bitset) \
+    do { \
+        if ((bitset) != NULL) { \
+            CDATA_FREE((void *)((char *)(bitset) - BITSET_HEADER_SIZE)); \
+        } \
+    } while (0)
+
+// Changes the number of bits. The new bits are zero.
+#define bitset_resize(bitset,bits) \
+    (((bitset) = _bitset_resize((bitset), (bits))), \
+    CDATA_ASSERT((bitset) != NULL))
+
+// The bitset grows if the index is past its end
+#define bitset_set(bitset,index) \
+    ((((bitset) == NULL) || ((index) >= bitset_size(bitset))) ? ((bitset) = _bitset_resize((bitset), (index) + 1)) : (bitset), \
+    CDATA_ASSERT((bitset) != NULL), \
+    ((bitset)[(index)/BITSET_WORD_BITS] |= ((uint64_t)1 << ((index) % BITSET_WORD_BITS))))
+#define bitset_clear(bitset,index) \
+    do { \
+        if (((bitset) != NULL) && ((index) < bitset_size(bitset))) { \
+            (bitset)[(index)/BITSET_WORD_BITS] &= ~((uint64_t)1 << ((index) % BITSET_WORD_BITS)); \
+        } \
+    } while (0)
+#define bitset_test(bitset,index) \
+    (((bitset) != NULL) && ((index) < bitset_size(bitset)) && \
+    ((((bitset)[(index)/BITSET_WORD_BITS] >> ((index) % BITSET_WORD_BITS)) & 1) != 0))
+// Clears all the bits, keeping the size
+#define bitset_clear_all(bitset) \
+    do { \
+        if ((bitset) != NULL) { \
+            CDATA_MEMSET((bitset), 0, array_size(bitset)*sizeof(uint64_t)); \
+        } \
+    } while (0)
+
+// Operations in place (dst = dst OP src). The result of bitset_or and
+// bitset_xor has the size of the biggest bitset, while bitset_and and
+// bitset_andnot (dst AND NOT src) keep the size of dst.
+#define bitset_and(dst,src)                     ((dst) = _bitset_operation((dst), (src), BITSET_AND))
+#define bitset_or(dst,src)                      ((dst) = _bitset_operation((dst), (src), BITSET_OR))
+#define bitset_xor(dst,src)                     ((dst) = _bitset_operation((dst), (src), BITSET_XOR))
+#define bitset_andnot(dst,src)                  ((dst) = _bitset_operation((dst), (src), BITSET_ANDNOT))
+
+// Visits the index of each set bit, in ascending order
+#define bitset_for_each(bitset,index) \
+    for (size_t (index) = bitset_find_next((bitset), 0); ((bitset) != NULL) && ((index) < bitset_size(bitset)); (index) = bitset_find_next((bitset), (index) + 1))
+
+// Builds the rank index of the bitset, which is a dynamic array of size_t.
+// It should be built again after the bitset is modified.
+#define bitset_rank_build(rank_index,bitset) \
+    ((rank_index) = _bitset_rank_build((rank_index), (bitset)))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    BITSET_AND,
+    BITSET_OR,
+    BITSET_XOR,
+    BITSET_ANDNOT,
+} Bitset_Operation;
+
+// Number of set bits
+CDATA_FCN_DEF size_t bitset_popcount(const uint64_t *bitset)
+    __attribute__((warn_unused_result));
+// Returns the index of the first set bit not before index, or bitset_size if there is none
+CDATA_FCN_DEF size_t bitset_find_next(const uint64_t *bitset, size_t index)
+    __attribute__((warn_unused_result));
+// Number of set bits before index, counting the words one by one
+CDATA_FCN_DEF size_t bitset_rank(const uint64_t *bitset, size_t index)
+    __attribute__((warn_unused_result));
+// Same as bitset_rank, in constant time, using the index built by bitset_rank_build
+CDATA_FCN_DEF size_t bitset_rank_indexed(const uint64_t *bitset, const size_t *rank_index, size_t index)
+    __attribute__((warn_unused_result));
+
+// This functions shouldn't be called directly, insted use the macros defined above
+CDATA_FCN_DEF uint64_t *_bitset_resize(uint64_t *bitset, size_t bits)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF uint64_t *_bitset_operation(uint64_t *dst, const uint64_t *src, Bitset_Operation operation)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF size_t *_bitset_rank_build(size_t *rank_index, const uint64_t *bitset)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF size_t _bitset_popcount_words(const uint64_t *words, size_t count)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF size_t _bitset_popcount64(uint64_t word)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF size_t _bitset_ctz64(uint64_t word)
+    __attribute__((warn_unused_result));
+
+#ifdef __cplusplus
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Slot map
+// Keeps elements of a fixed size densely packed in a dynamic array, and
+// refers to them through handles which stay valid while the element exists.
+// Insertions and removals take O(1), since the last element is moved to the
+// place of the removed one. Each handle holds a 32 bits slot and the 32 bits
+// generation of that slot, which changes when the element is removed, so the
+// handles of removed elements are detected (slot_map_get returns NULL).
+// The generation of a slot is odd while it holds an element, so a valid
+// handle is never zero.
+
+#define SLOT_MAP_HANDLE_INVALID                 ((Slot_Map_Handle)0)
+#define SLOT_MAP_FREE_LIST_END                  UINT32_MAX
+
+#define slot_map_new(type)                      _slot_map_new(sizeof(type))
+#define slot_map_size(map)                      (array_is_empty((map)->element_slots) ? 0 : array_size((map)->element_slots))
+#define slot_map_is_empty(map)                  (slot_map_size(map) == 0)
+
+// The elements are a dynamic array, which may be iterated directly. Its
+// order changes when elements are removed.
+#define slot_map_elements(map)                  ((map)->elements)
+#define slot_map_element_at(map,index) \
+    array_compute_address_at((map)->elements, (map)->element_size, (index))
+// Handle of the element at the position of the array of elements
+#define slot_map_handle_at(map,index) \
+    _slot_map_handle((map)->element_slots[(index)], (map)->slots[(map)->element_slots[(index)]].generation)
+
+#define slot_map_handle_slot(handle)            ((uint32_t)((handle) & 0xFFFFFFFFU))
+#define slot_map_handle_generation(handle)      ((uint32_t)((handle) >> 32))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint64_t Slot_Map_Handle;
+
+typedef struct {
+    uint32_t index;                 // Position of the element, or the next free slot
+    uint32_t generation;
+} Slot_Map_Slot;
+
+typedef struct {
+    size_t element_size;
+    void *elements;                 // Dynamic array of elements
+    uint32_t *element_slots;        // Dynamic array with the slot of each element
+    Slot_Map_Slot *slots;           // Dynamic array indexed by the handles
+    uint32_t free_slots;            // Head of the list of free slots
+} Slot_Map;
+
+CDATA_FCN_DEF Slot_Map _slot_map_new(size_t element_size)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF void slot_map_delete(Slot_Map *map)
+    __attribute__((nonnull));
+// Removes every element, invalidating all the handles
+CDATA_FCN_DEF void slot_map_clear(Slot_Map *map)
+    __attribute__((nonnull));
+// Copies the value to the map (or fills the element with zeros, if value is
+// NULL), and returns its handle, or SLOT_MAP_HANDLE_INVALID if there are no
+// more slots
+CDATA_FCN_DEF Slot_Map_Handle slot_map_insert(Slot_Map *map, const void *value)
+    __attribute__((warn_unused_result, nonnull(1)));
+// Returns the address of the element, or NULL if the handle isn't valid. The
+// address is invalidated by insertions and removals.
+CDATA_FCN_DEF void *slot_map_get(const Slot_Map *map, Slot_Map_Handle handle)
+    __attribute__((warn_unused_result, nonnull));
+// Returns 1 if the element was removed, and 0 if the handle isn't valid
+CDATA_FCN_DEF int slot_map_remove(Slot_Map *map, Slot_Map_Handle handle)
+    __attribute__((nonnull));
+
+// This functions shouldn't be called directly
+CDATA_FCN_DEF Slot_Map_Handle _slot_map_handle(uint32_t slot, uint32_t generation)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF void _slot_map_free_slot(Slot_Map *map, uint32_t slot)
+    __attribute__((nonnull));
+
+#ifdef __cplusplus
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Cache
+// Fixed capacity map which evicts an element when a new one is inserted while
+// it is full. The elements are stored inline in an open addressing table
+// (with linear probing), which is allocated once, together with the cache,
+// and never resized. The removals shift back the following elements of the
+// probe sequence, so that no tombstones are needed. Every operation takes
+// O(1), and the eviction policy may be:
+//  - CACHE_LRU: evicts the least recently used element. The elements are
+//    kept in a doubly linked list (of positions in the table), ordered by use;
+//  - CACHE_CLOCK: approximation of LRU which only sets a bit when an element
+//    is used. A hand sweeps the table, clearing these bits, and evicts the
+//    first element whose bit was already clear.
+
+#define CACHE_NO_SLOT                           UINT32_MAX
+
+#define cache_new(type,capacity,policy,hash_function,compare_key) \
+    _cache_new(sizeof(type), (capacity), (policy), (hash_function), (compare_key))
+#define cache_delete(cache)                     CDATA_FREE(cache)
+
+#define cache_size(cache)                       ((cache)->size)
+#define cache_capacity(cache)                   ((cache)->capacity)
+#define cache_hits(cache)                       ((cache)->hits)
+#define cache_misses(cache)                     ((cache)->misses)
+#define cache_evictions(cache)                  ((cache)->evictions)
+#define cache_reset_stats(cache) \
+    ((cache)->hits = (cache)->misses = (cache)->evictions = 0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CACHE_LRU,
+    CACHE_CLOCK,
+} Cache_Policy;
+
+// Header of each slot of the table, which is followed by the element
+typedef struct {
+    size_t hash;
+    uint32_t previous;              // Neighbours in the list ordered by use (CACHE_LRU)
+    uint32_t next;
+    unsigned char occupied;
+    unsigned char referenced;       // Used bit (CACHE_CLOCK)
+} Cache_Slot;
+
+typedef struct {
+    size_t element_size;
+    size_t element_offset;          // Offset of the element in the slot, after its header
+    size_t slot_size;
+    size_t capacity;
+    size_t size;
+    size_t mask;                    // The number of slots (a power of two) minus one
+    Cache_Policy policy;
+    Hash_Fcn hash_function;
+    Compare_Fcn compare_key;
+    uint32_t most_recent;           // Ends of the list ordered by use (CACHE_LRU)
+    uint32_t least_recent;
+    size_t hand;                    // Position of the hand (CACHE_CLOCK)
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    char *slots;
+} Cache;
+
+CDATA_FCN_DEF Cache *_cache_new(size_t element_size, size_t capacity, Cache_Policy policy, Hash_Fcn hash_function, Compare_Fcn compare_key)
+    __attribute__((warn_unused_result, nonnull(4,5)));
+// Returns the address of the element equal to key, or NULL if it isn't
+// present, and marks it as used. The hits and misses are counted.
+CDATA_FCN_DEF void *cache_get(Cache *cache, const void *key)
+    __attribute__((warn_unused_result, nonnull));
+// Same as cache_get, without marking the element as used or counting the access
+CDATA_FCN_DEF void *cache_peek(const Cache *cache, const void *key)
+    __attribute__((warn_unused_result, nonnull));
+// Inserts the element, or replaces the equal one, marking it as used. Returns
+// 1 if another element was evicted to make room for it (and copies it to
+// evicted, if it isn't NULL), and 0 otherwise.
+CDATA_FCN_DEF int cache_put(Cache *cache, const void *element, void *evicted)
+    __attribute__((nonnull(1,2)));
+// Returns 1 if the element equal to key was removed (and copies it to
+// removed, if it isn't NULL), and 0 if it wasn't present
+CDATA_FCN_DEF int cache_remove(Cache *cache, const void *key, void *removed)
+    __attribute__((nonnull(1,2)));
+CDATA_FCN_DEF void cache_clear(Cache *cache)
+    __attribute__((nonnull));
+
+// This functions shouldn't be called directly
+CDATA_FCN_DEF size_t _cache_find(const Cache *cache, const void *key, size_t hash)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void _cache_touch(Cache *cache, size_t position)
+    __attribute__((nonnull));
+CDATA_FCN_DEF void _cache_link(Cache *cache, size_t position)
+    __attribute__((nonnull));
+CDATA_FCN_DEF void _cache_unlink(Cache *cache, size_t position)
+    __attribute__((nonnull));
+CDATA_FCN_DEF size_t _cache_victim(Cache *cache)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF void _cache_remove_at(Cache *cache, size_t position)
+    __attribute__((nonnull));
+
+#ifdef __cplusplus
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Bounded multi-producer multi-consumer queue
+// Lock-free FIFO queue of elements of a fixed size, shared between threads,
+// with the algorithm of Dmitry Vyukov. The elements are stored in a ring of
+// cells, each one with a sequence number that tells whether the cell is
+// ready to be written by the producer, or read by the consumer, of a given
+// position. A thread claims a position with a single compare-and-swap, and
+// then copies the element without blocking the other threads. The batch
+// operations claim several consecutive positions with one compare-and-swap.
+
+#define mpmc_queue_new(type,capacity)           _mpmc_queue_new(sizeof(type), (capacity))
+#define mpmc_queue_delete(queue)                CDATA_FREE(queue)
+#define mpmc_queue_capacity(queue)              ((queue)->mask + 1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The positions are kept in different cache lines, so that the producers
+// and the consumers don't slow each other down
+typedef struct {
+    size_t element_size;
+    size_t element_offset;          // Offset of the element in the cell, after its sequence number
+    size_t cell_size;
+    size_t mask;                    // The capacity (a power of two) minus one
+    char *cells;                    // Sequence number followed by the element
+    char padding0[CDATA_CACHE_LINE_SIZE];
+    size_t enqueue_position;
+    char padding1[CDATA_CACHE_LINE_SIZE];
+    size_t dequeue_position;
+    char padding2[CDATA_CACHE_LINE_SIZE];
+} Mpmc_Queue;
+
+// The capacity is rounded up to a power of two
+CDATA_FCN_DEF Mpmc_Queue *_mpmc_queue_new(size_t element_size, size_t capacity)
+    __attribute__((warn_unused_result));
+// Returns 1 if the element was copied to the queue, and 0 if it is full
+CDATA_FCN_DEF int mpmc_queue_enqueue(Mpmc_Queue *queue, const void *element)
+    __attribute__((nonnull));
+// Returns 1 if an element was removed from the queue (and copied to
+// element), and 0 if it is empty
+CDATA_FCN_DEF int mpmc_queue_dequeue(Mpmc_Queue *queue, void *element)
+    __attribute__((nonnull));
+// Enqueues as many of the count elements as there is room for, in order,
+// and returns how many were enqueued
+CDATA_FCN_DEF size_t mpmc_queue_enqueue_batch(Mpmc_Queue *queue, const void *elements, size_t count)
+    __attribute__((nonnull));
+// Dequeues up to count elements, and returns how many were dequeued
+CDATA_FCN_DEF size_t mpmc_queue_dequeue_batch(Mpmc_Queue *queue, void *elements, size_t count)
+    __attribute__((nonnull));
+// Number of elements in the queue, which may already be outdated when it
+// is returned, if other threads are using the queue
+CDATA_FCN_DEF size_t mpmc_queue_size(Mpmc_Queue *queue)
+    __attribute__((warn_unused_result, nonnull));
+
+// This functions shouldn't be called directly
+CDATA_FCN_DEF size_t _mpmc_queue_claim(Mpmc_Queue *queue, size_t *shared_position, size_t ready_offset, size_t count, size_t *first)
+    __attribute__((warn_unused_result, nonnull));
+
+#ifdef __cplusplus
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Thread pool and parallel loops
+// Only available when CDATA_THREADS is defined, since it needs POSIX threads.
+// The pool keeps its threads waiting for the next loop, and the calling
+// thread also works on each loop. The range of the loop is split evenly
+// among the threads, and each thread takes chunks from the beginning of its
+// part, starting with big chunks, which shrink as the part gets smaller
+// (down to PARALLEL_MIN_CHUNK). A thread that finishes its part steals half
+// of what remains of the part of another thread, from its end.
+// Loops over less than PARALLEL_SERIAL_THRESHOLD elements, or with a NULL
+// pool, run only in the calling thread. A pool runs one loop at a time, so
+// the loops shouldn't be started from inside the functions called by them.
+
+#ifdef CDATA_THREADS
+
+#include <pthread.h>
+
+#define thread_pool_threads(pool)               (((pool) != NULL) ? (pool)->threads : 1)
+
+// The function is called for ranges [begin, end) of the indexes of the array,
+// with the array as its data argument
+#define array_parallel_for(pool,array,fcn,context) \
+    thread_pool_parallel_for((pool), (array_is_empty(array) ? 0 : array_size(array)), \
+        PARALLEL_MIN_CHUNK, (Thread_Pool_Fcn)(fcn), (array), (context))
+// Each thread reduces its ranges to its own copy of the initial value of the
+// accumulator, which should be the identity of the combine function (zero,
+// for a sum). Then, the copies are combined into the accumulator, in an
+// unspecified order.
+#define array_parallel_reduce(pool,array,accumulator,reduce,combine,context) \
+    _array_parallel_reduce((pool), (array), (array_is_empty(array) ? 0 : array_size(array)), \
+        (accumulator), sizeof(*(accumulator)), (reduce), (combine), (context))
+// The occupancy bitmap of the table is split among the threads by ranges of words
+#define hash_table_parallel_for_each(pool,hash_table,fcn,context) \
+    _hash_table_parallel_for_each((pool), (hash_table), sizeof(*(hash_table)), (fcn), (context))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Function called by the parallel loops for each range [begin, end) of the
+// loop, by the thread of the specified index (in [0, thread_pool_threads))
+typedef void (*Thread_Pool_Fcn)(void *context, void *data, size_t begin, size_t end, size_t thread);
+typedef void (*Parallel_Reduce_Fcn)(void *context, void *accumulator, const void *array, size_t begin, size_t end);
+typedef void (*Parallel_Combine_Fcn)(void *context, void *accumulator, const void *partial);
+// Function called for each element of the hash table
+typedef void (*Hash_Table_Parallel_Fcn)(void *context, void *element);
+
+// Part of the range of the loop that is left to a thread
+typedef struct {
+    Spinlock lock;
+    size_t begin;
+    size_t end;
+    char padding[CDATA_CACHE_LINE_SIZE];
+} Thread_Pool_Range;
+
+typedef struct {
+    Parallel_Reduce_Fcn reduce;
+    const void *array;
+    char *partials;                 // Accumulator of each thread
+    size_t accumulator_size;
+} Array_Parallel_Reduce_Task;
+
+typedef struct {
+    Hash_Table_Parallel_Fcn fcn;
+    void *hash_table;
+    size_t element_size;
+} Hash_Table_Parallel_Task;
+
+typedef struct Thread_Pool Thread_Pool;
+
+typedef struct {
+    Thread_Pool *pool;
+    size_t index;
+    pthread_t thread;
+} Thread_Pool_Worker;
+
+struct Thread_Pool {
+    size_t threads;                 // Including the calling thread
+    Thread_Pool_Worker *workers;
+    Thread_Pool_Range *ranges;
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t finish;
+    size_t generation;              // Number of loops started
+    size_t running;                 // Workers still running the current loop
+    int stop;
+    // Current loop
+    Thread_Pool_Fcn fcn;
+    void *data;
+    void *context;
+    size_t min_chunk;
+};
+
+// Creates a pool with the specified number of threads, including the calling
+// thread, or with one thread per processor if threads is zero
+CDATA_FCN_DEF Thread_Pool *thread_pool_new(size_t threads)
+    __attribute__((warn_unused_result));
+CDATA_FCN_DEF void thread_pool_delete(Thread_Pool *pool);
+// Calls fcn for ranges of [0, count), with at least min_chunk elements
+// (except the last ones), and returns after all of them are processed
+CDATA_FCN_DEF void thread_pool_parallel_for(Thread_Pool *pool, size_t count, size_t min_chunk, Thread_Pool_Fcn fcn, void *data, void *context)
+    __attribute__((nonnull(4)));
+
+// This functions shouldn't be called directly, insted use the macros defined above
+CDATA_FCN_DEF void _array_parallel_reduce(Thread_Pool *pool, const void *array, size_t size, void *accumulator, size_t accumulator_size, Parallel_Reduce_Fcn reduce, Parallel_Combine_Fcn combine, void *context)
+    __attribute__((nonnull(4,6,7)));
+CDATA_FCN_DEF void _hash_table_parallel_for_each(Thread_Pool *pool, void *hash_table, size_t element_size, Hash_Table_Parallel_Fcn fcn, void *context)
+    __attribute__((nonnull(2,4)));
+CDATA_FCN_DEF void _array_parallel_reduce_range(void *context, void *data, size_t begin, size_t end, size_t thread)
+    __attribute__((nonnull(2)));
+CDATA_FCN_DEF void _hash_table_parallel_for_each_range(void *context, void *data, size_t begin, size_t end, size_t thread)
+    __attribute__((nonnull(2)));
+CDATA_FCN_DEF void *_thread_pool_worker_run(void *worker)
+    __attribute__((nonnull));
+CDATA_FCN_DEF void _thread_pool_work(Thread_Pool *pool, size_t index)
+    __attribute__((nonnull));
+CDATA_FCN_DEF int _thread_pool_take(Thread_Pool_Range *range, size_t min_chunk, size_t *begin, size_t *end)
+    __attribute__((warn_unused_result, nonnull));
+CDATA_FCN_DEF int _thread_pool_steal(Thread_Pool_Range *victim, Thread_Pool_Range *thief, size_t min_chunk)
+    __attribute__((warn_unused_result, nonnull));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CDATA_THREADS
+
+#endif  // __CDATA_HEADER_ONLY_LIBRARY
+
+//------------------------------------------------------------------------------
+// SOURCE
+//------------------------------------------------------------------------------
+
+#ifdef CDATA_IMPLEMENTATION
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CDATA_STATS
+
+Cdata_Stats cdata_stats = { 0 };
+
+CDATA_FCN_DEF void cdata_stats_reset(void) {
+    CDATA_MEMSET(&cdata_stats, 0, sizeof(cdata_stats));
+}
+
+CDATA_FCN_DEF void cdata_stats_dump(FILE *stream) {
+    fprintf(stream, "cdata statistics:\n");
+    fprintf(stream, "  dynamic arrays:\n");
+    fprintf(stream, "    resizes: %zu\n", cdata_stats.arrays.resizes);
+    fprintf(stream, "    bytes moved: %zu\n", cdata_stats.arrays.bytes_moved);
+    fprintf(stream, "  hash tables:\n");
+    fprintf(stream, "    lookups: %zu\n", cdata_stats.hash_tables.lookups);
+    if (cdata_stats.hash_tables.lookups > 0) {
+        fprintf(stream, "    mean probe length: %g\n",
+            (double)cdata_stats.hash_tables.probes / (double)cdata_stats.hash_tables.lookups);
+        fprintf(stream, "    probe length histogram:\n");
+        for (size_t i = 0; i < CDATA_STATS_PROBE_BUCKETS; i++) {
+            const size_t count = cdata_stats.hash_tables.probe_histogram[i];
+            if (count == 0) {
+                continue;
+            }
+            const char *suffix = (i == CDATA_STATS_PROBE_BUCKETS - 1) ? "+" : " ";
+            fprintf(stream, "      %3zu%s %12zu (%5.2f%%)\n", i, suffix, count,
+                100.0 * (double)count / (double)cdata_stats.hash_tables.lookups);
+        }
+    }
+    fprintf(stream, "    resizes: %zu\n", cdata_stats.hash_tables.resizes);
+    fprintf(stream, "    resize time: %gs\n", (double)cdata_stats.hash_tables.resize_clocks / CLOCKS_PER_SEC);
+    fprintf(stream, "  arenas:\n");
+    fprintf(stream, "    regions: %zu\n", cdata_stats.arenas.regions);
+    fprintf(stream, "    region bytes: %zu\n", cdata_stats.arenas.region_bytes);
+    fprintf(stream, "    allocations: %zu\n", cdata_stats.arenas.allocations);
+    fprintf(stream, "    allocated bytes: %zu\n", cdata_stats.arenas.allocated_bytes);
+    fprintf(stream, "    wasted tail bytes: %zu\n", cdata_stats.arenas.wasted_bytes);
+}
+
+#endif // CDATA_STATS
+
+// Function stolen from https://handwiki.org/wiki/Quadratic_probing
+CDATA_FCN_DEF size_t round_up_2(size_t value) {
+    value--;
+    value |= value >> 1;
+    value |= value >> 2;
+    value |= value >> 4;
+    value |= value >> 8;
+    value |= value >> 16;
+    value |= value >> 32;
+    value++;
+    return value;
+}
+
+CDATA_FCN_DEF void *_array_resize(void *array, size_t element_size, size_t header_size, size_t new_capacity) {
+    void *new_p = NULL;
+    if (array == NULL) {
+        new_p = CDATA_REALLOC(NULL, new_capacity * element_size + header_size);
+        if (new_p == NULL) {
+            return(NULL);
+        }
+        CDATA_MEMSET(new_p, 0, header_size);
+    } else if (array_has_inline_storage(array)) {
+        // The storage doesn't belong to the array, so it is copied to the heap
+        new_p = CDATA_REALLOC(NULL, new_capacity * element_size + header_size);
+        if (new_p == NULL) {
+            return(NULL);
+        }
+        CDATA_MEMCPY(new_p, (char *)array - header_size, array_capacity(array) * element_size + header_size);
+    } else {
+        void *p = (void *)((size_t)array - header_size);
+        new_p = CDATA_REALLOC(p, new_capacity * element_size + header_size);
+        if (new_p == NULL) {
+            CDATA_FREE(p);
+            return(NULL);
+        }
+    }
+    void *new_array = (char *)new_p + header_size;
+    void *address = array_compute_address_at(new_array, element_size, array_capacity(new_array));
+    size_t length = (new_capacity - array_capacity(new_array));
+    CDATA_MEMSET(address, 0, length * element_size);
+    // Also clears ARRAY_INLINE_STORAGE_FLAG
+    _array_capacity_field(new_array) = new_capacity;
+    return(new_array);
+}
+
+CDATA_FCN_DEF void *_array_resize_if_needed(void *array, size_t element_size, size_t size_to_add) {
+    if (array == NULL) {
+        size_t new_capacity = INT_MAX(size_to_add, ARRAY_DEFAULT_CAPACITY);
+        new_capacity = round_up_2(new_capacity);
+        array = _array_resize(NULL, element_size, ARRAY_HEADER_SIZE, new_capacity);
+        if (array == NULL) {
+            return NULL;
+        }
+    }
+    size_t new_size = array_size(array) + size_to_add;
+    if (new_size > array_capacity(array)) {
+        size_t new_capacity = array_capacity(array);
+        while (new_size > new_capacity) {
+            new_capacity *= GROWTH_FACTOR;
+        }
+        new_capacity = round_up_2(new_capacity);
+        array = _array_resize(array, element_size, ARRAY_HEADER_SIZE, new_capacity);
+        CDATA_STATS_ADD(arrays.resizes, 1);
+    }
+    return array;
+}
+
+CDATA_FCN_DEF void *_array_use_storage(void *storage, size_t storage_size, size_t element_size) {
+    CDATA_ASSERT(storage_size >= ARRAY_HEADER_SIZE + element_size);
+    void *array = (char *)storage + ARRAY_HEADER_SIZE;
+    const size_t capacity = (storage_size - ARRAY_HEADER_SIZE)/element_size;
+    // As in the arrays allocated in the heap, the elements after the end are zero
+    CDATA_MEMSET(array, 0, capacity*element_size);
+    array_size(array) = 0;
+    _array_capacity_field(array) = capacity | ARRAY_INLINE_STORAGE_FLAG;
+    return array;
+}
+
+CDATA_FCN_DEF void *_array_insert_zero_at(void *array, size_t element_size, size_t index) {
+    size_t old_size = (array == NULL) ? 0 : array_size(array);
+    size_t size_to_add = array_index_is_valid(array, index) ? 1 : ((index) + 1 - old_size);
+    array = _array_resize_if_needed(array, element_size, size_to_add);
+    if (array != NULL) {
+        void *actual = array_compute_address_at(array, element_size, index);
+        if (index < old_size) {
+            void *next = array_compute_address_at(array, element_size, (index+1));
+            size_t length = old_size - index;
+            CDATA_MEMMOVE(next, actual, length*element_size);
+            CDATA_STATS_ADD(arrays.bytes_moved, length*element_size);
+        }
+        CDATA_MEMSET(actual, 0, element_size);
+        array_size(array) = old_size + size_to_add;
+    }
+    return(array);
+}
+
+// This function returns an invalid index in case the key wasn't found
+CDATA_FCN_DEF size_t _array_sequential_search(const void *array, size_t element_size, const void *key, Compare_Fcn compare) {
+    if (array != NULL) {
+        for (size_t i = 0; i < array_size(array); i++) {
+            const void *it = array_compute_address_at(array, element_size, i);
+            if (!compare(key, it)) {
+                return(i);
+            }
+        }
+    }
+    return((size_t)-1);
+}
+
+// This function returns an invalid index in case the key wasn't found
+CDATA_FCN_DEF size_t _array_binary_search(const void *array, size_t element_size, const void *key, Compare_Fcn compare) {
+    if (array == NULL) {
+        return((size_t)-1);
+    }
+    size_t index;
+    size_t low = 0;
+    size_t high = array_size(array) - 1;
+    while ((low <= high) && array_index_is_valid(array, high)) {
+        index = low + (high - low) / 2; // middle
+        const void *it = array_compute_address_at(array, element_size, index);
+        const int comp = compare(key, it);
+        if (comp < 0) {
+            high = index - 1;
+        } else if (comp > 0) {
+            low = index + 1;
+        } else {
+            return(index);
+        }
+    }
+    // Didn't found the key
+    // Return an invalid index, but with enought information so that _array_insert_sorted
+    // can recover the ideal position for the element to be inserted
+    index = (size_t)-1*(low+1);
+    return(index);
+}
+
+// This function returns 1 if a new element was inserted, and 0 if that element is already in the array
 CDATA_FCN_DEF int _array_insert_sorted(void **array, size_t element_size, const void *element, Compare_Fcn compare, size_t *const user_index) {
     if (*array == NULL) {
         array_push_raw(*array, element, element_size);
         if (user_index != NULL) {
             *user_index = 0;
         }
-        return(1);
+        return(1);
+    }
+    size_t index = _array_binary_search(*array, element_size, element, compare);
+    if (array_index_is_valid(*array, index)) {
+        if (user_index != NULL) {
+            *user_index = index;
+        }
+        return(0);
+    }
+    // Insert new element
+    index = (size_t)(-1L*(long)index - 1);
+    *array = _array_insert_zero_at(*array, element_size, index);
+    if (*array == NULL) {
+        return(-1);
+    }
+    void *it = array_compute_address_at(*array, element_size, index);
+    CDATA_MEMCPY(it, element, element_size);
+    if (user_index != NULL) {
+        *user_index = index;
+    }
+    return(1);
+}
+
+// Returns the index of the first element not less than key, in [start, size).
+// The search range doubles until it passes the key, so it takes O(log d)
+// comparisons, where d is the distance from start to the result.
+CDATA_FCN_DEF size_t _array_gallop(const void *array, size_t size, size_t element_size, const void *key, Compare_Fcn compare, size_t start) {
+    const char *elements = array;
+    size_t low = start;
+    size_t step = 1;
+    while ((low < size) && (compare(elements + low*element_size, key) < 0)) {
+        start = low + 1;
+        low += step;
+        step *= 2;
+    }
+    // The result is in [start, min(low, size)]
+    size_t high = INT_MIN(low, size);
+    while (start < high) {
+        const size_t middle = start + (high - start) / 2;
+        if (compare(elements + middle*element_size, key) < 0) {
+            start = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return start;
+}
+
+// Makes sure that the output can hold max_size elements, and clears it
+CDATA_FCN_DEF void *_array_sorted_output(void *output, size_t element_size, size_t max_size) {
+    if ((output == NULL) || (array_capacity(output) < max_size)) {
+        output = _array_resize(output, element_size, ARRAY_HEADER_SIZE, INT_MAX(max_size, (size_t)1));
+        if (output == NULL) {
+            return NULL;
+        }
+    }
+    array_size(output) = 0;
+    return output;
+}
+
+#define _array_sorted_size(array)       (array_is_empty(array) ? 0 : array_size(array))
+#define _array_sorted_append(output,element_size,source,count) \
+    do { \
+        if ((count) > 0) { \
+            CDATA_MEMCPY(array_compute_address_at((output), (element_size), array_size(output)), (source), (count)*(element_size)); \
+            array_size(output) += (count); \
+        } \
+    } while (0)
+
+CDATA_FCN_DEF void *_array_sorted_union(void *output, const void *a, const void *b, size_t element_size, Compare_Fcn compare) {
+    const size_t size_a = _array_sorted_size(a);
+    const size_t size_b = _array_sorted_size(b);
+    output = _array_sorted_output(output, element_size, size_a + size_b);
+    if (output == NULL) {
+        return NULL;
+    }
+    const char *elements_a = a;
+    const char *elements_b = b;
+    size_t i = 0;
+    size_t j = 0;
+    if ((size_a >= ARRAY_GALLOP_RATIO*size_b) || (size_b >= ARRAY_GALLOP_RATIO*size_a)) {
+        // Copies whole runs of the bigger array between the elements of the smaller one
+        const int a_is_small = (size_a < size_b);
+        const char *small = a_is_small ? elements_a : elements_b;
+        const char *big = a_is_small ? elements_b : elements_a;
+        const size_t small_size = a_is_small ? size_a : size_b;
+        const size_t big_size = a_is_small ? size_b : size_a;
+        for (; i < small_size; i++) {
+            const char *element = small + i*element_size;
+            const size_t position = _array_gallop(big, big_size, element_size, element, compare, j);
+            _array_sorted_append(output, element_size, big + j*element_size, position - j);
+            j = position;
+            if ((j < big_size) && (compare(big + j*element_size, element) == 0)) {
+                _array_sorted_append(output, element_size, (a_is_small ? element : big + j*element_size), 1);
+                j++;
+            } else {
+                _array_sorted_append(output, element_size, element, 1);
+            }
+        }
+        _array_sorted_append(output, element_size, big + j*element_size, big_size - j);
+        return output;
+    }
+    while ((i < size_a) && (j < size_b)) {
+        const int result = compare(elements_a + i*element_size, elements_b + j*element_size);
+        if (result <= 0) {
+            _array_sorted_append(output, element_size, elements_a + i*element_size, 1);
+            i++;
+            j += (result == 0);
+        } else {
+            _array_sorted_append(output, element_size, elements_b + j*element_size, 1);
+            j++;
+        }
+    }
+    _array_sorted_append(output, element_size, elements_a + i*element_size, size_a - i);
+    _array_sorted_append(output, element_size, elements_b + j*element_size, size_b - j);
+    return output;
+}
+
+CDATA_FCN_DEF void *_array_sorted_intersect(void *output, const void *a, const void *b, size_t element_size, Compare_Fcn compare) {
+    const size_t size_a = _array_sorted_size(a);
+    const size_t size_b = _array_sorted_size(b);
+    output = _array_sorted_output(output, element_size, INT_MIN(size_a, size_b));
+    if (output == NULL) {
+        return NULL;
+    }
+    const char *elements_a = a;
+    const char *elements_b = b;
+    size_t i = 0;
+    size_t j = 0;
+    if ((size_a >= ARRAY_GALLOP_RATIO*size_b) || (size_b >= ARRAY_GALLOP_RATIO*size_a)) {
+        // Looks for each element of the smaller array in the bigger one
+        const int a_is_small = (size_a < size_b);
+        const char *small = a_is_small ? elements_a : elements_b;
+        const char *big = a_is_small ? elements_b : elements_a;
+        const size_t small_size = a_is_small ? size_a : size_b;
+        const size_t big_size = a_is_small ? size_b : size_a;
+        for (; (i < small_size) && (j < big_size); i++) {
+            const char *element = small + i*element_size;
+            j = _array_gallop(big, big_size, element_size, element, compare, j);
+            if ((j < big_size) && (compare(big + j*element_size, element) == 0)) {
+                _array_sorted_append(output, element_size, (a_is_small ? element : big + j*element_size), 1);
+                j++;
+            }
+        }
+        return output;
+    }
+    while ((i < size_a) && (j < size_b)) {
+        const int result = compare(elements_a + i*element_size, elements_b + j*element_size);
+        if (result == 0) {
+            _array_sorted_append(output, element_size, elements_a + i*element_size, 1);
+        }
+        i += (result <= 0);
+        j += (result >= 0);
+    }
+    return output;
+}
+
+CDATA_FCN_DEF void *_array_sorted_difference(void *output, const void *a, const void *b, size_t element_size, Compare_Fcn compare) {
+    const size_t size_a = _array_sorted_size(a);
+    const size_t size_b = _array_sorted_size(b);
+    output = _array_sorted_output(output, element_size, size_a);
+    if (output == NULL) {
+        return NULL;
+    }
+    const char *elements_a = a;
+    const char *elements_b = b;
+    size_t i = 0;
+    size_t j = 0;
+    if (size_a >= ARRAY_GALLOP_RATIO*size_b) {
+        // Copies whole runs of a between the elements of b
+        for (; (j < size_b) && (i < size_a); j++) {
+            const char *element = elements_b + j*element_size;
+            const size_t position = _array_gallop(elements_a, size_a, element_size, element, compare, i);
+            _array_sorted_append(output, element_size, elements_a + i*element_size, position - i);
+            i = position;
+            if ((i < size_a) && (compare(elements_a + i*element_size, element) == 0)) {
+                i++;
+            }
+        }
+        _array_sorted_append(output, element_size, elements_a + i*element_size, size_a - i);
+        return output;
+    }
+    if (size_b >= ARRAY_GALLOP_RATIO*size_a) {
+        // Looks for each element of a in b
+        for (; (i < size_a) && (j < size_b); i++) {
+            const char *element = elements_a + i*element_size;
+            j = _array_gallop(elements_b, size_b, element_size, element, compare, j);
+            if ((j < size_b) && (compare(elements_b + j*element_size, element) == 0)) {
+                j++;
+            } else {
+                _array_sorted_append(output, element_size, element, 1);
+            }
+        }
+        _array_sorted_append(output, element_size, elements_a + i*element_size, size_a - i);
+        return output;
+    }
+    while ((i < size_a) && (j < size_b)) {
+        const int result = compare(elements_a + i*element_size, elements_b + j*element_size);
+        if (result < 0) {
+            _array_sorted_append(output, element_size, elements_a + i*element_size, 1);
+        }
+        i += (result <= 0);
+        j += (result >= 0);
+    }
+    _array_sorted_append(output, element_size, elements_a + i*element_size, size_a - i);
+    return output;
+}
+
+// The arrays are kept in a min-heap ordered by their next element, with the
+// ties broken by the index of the array, so that the merge is stable
+CDATA_FCN_DEF void *_array_sorted_merge(void *output, const void *const *arrays, size_t count, size_t element_size, Compare_Fcn compare) {
+    size_t total = 0;
+    for (size_t k = 0; k < count; k++) {
+        total += _array_sorted_size(arrays[k]);
+    }
+    if (total == 0) {
+        return _array_sorted_output(output, element_size, total);
+    }
+    // Allocated before the output is changed, which is kept if this fails
+    size_t *heap = CDATA_REALLOC(NULL, 2*count*sizeof(size_t));
+    if (heap == NULL) {
+        return output;
+    }
+    output = _array_sorted_output(output, element_size, total);
+    if (output == NULL) {
+        CDATA_FREE(heap);
+        return NULL;
+    }
+    size_t *positions = heap + count;
+    size_t heap_size = 0;
+    for (size_t k = 0; k < count; k++) {
+        positions[k] = 0;
+        if (_array_sorted_size(arrays[k]) > 0) {
+            heap[heap_size++] = k;
+        }
+    }
+#define _array_sorted_merge_less(x,y) \
+    _array_sorted_merge_compare(arrays, positions, element_size, compare, (x), (y))
+    // Builds the heap
+    for (size_t start = heap_size / 2; start-- > 0;) {
+        for (size_t position = start;;) {
+            size_t smallest = position;
+            const size_t left = 2*position + 1;
+            const size_t right = left + 1;
+            if ((left < heap_size) && _array_sorted_merge_less(heap[left], heap[smallest])) {
+                smallest = left;
+            }
+            if ((right < heap_size) && _array_sorted_merge_less(heap[right], heap[smallest])) {
+                smallest = right;
+            }
+            if (smallest == position) {
+                break;
+            }
+            const size_t tmp = heap[position];
+            heap[position] = heap[smallest];
+            heap[smallest] = tmp;
+            position = smallest;
+        }
+    }
+    while (heap_size > 0) {
+        const size_t k = heap[0];
+        const char *elements = arrays[k];
+        _array_sorted_append(output, element_size, elements + positions[k]*element_size, 1);
+        positions[k]++;
+        if (positions[k] == array_size(arrays[k])) {
+            heap[0] = heap[--heap_size];
+        }
+        for (size_t position = 0;;) {
+            size_t smallest = position;
+            const size_t left = 2*position + 1;
+            const size_t right = left + 1;
+            if ((left < heap_size) && _array_sorted_merge_less(heap[left], heap[smallest])) {
+                smallest = left;
+            }
+            if ((right < heap_size) && _array_sorted_merge_less(heap[right], heap[smallest])) {
+                smallest = right;
+            }
+            if (smallest == position) {
+                break;
+            }
+            const size_t tmp = heap[position];
+            heap[position] = heap[smallest];
+            heap[smallest] = tmp;
+            position = smallest;
+        }
+    }
+#undef _array_sorted_merge_less
+    CDATA_FREE(heap);
+    return output;
+}
+
+CDATA_FCN_DEF int _array_sorted_merge_compare(const void *const *arrays, const size_t *positions, size_t element_size, Compare_Fcn compare, size_t x, size_t y) {
+    const int result = compare((const char *)arrays[x] + positions[x]*element_size, (const char *)arrays[y] + positions[y]*element_size);
+    return (result < 0) || ((result == 0) && (x < y));
+}
+
+CDATA_FCN_DEF int _array_compare_u32(const void *a, const void *b) {
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+CDATA_FCN_DEF uint32_t *_array_sorted_intersect_u32(uint32_t *output, const uint32_t *a, const uint32_t *b) {
+    const size_t size_a = _array_sorted_size(a);
+    const size_t size_b = _array_sorted_size(b);
+    if ((size_a >= ARRAY_GALLOP_RATIO*size_b) || (size_b >= ARRAY_GALLOP_RATIO*size_a)) {
+        return _array_sorted_intersect(output, a, b, sizeof(uint32_t), _array_compare_u32);
+    }
+    output = _array_sorted_output(output, sizeof(uint32_t), INT_MIN(size_a, size_b));
+    if (output == NULL) {
+        return NULL;
+    }
+    size_t i = 0;
+    size_t j = 0;
+    size_t size = 0;
+#ifdef CDATA_SSE2_SUPPORTED
+    // Compares blocks of four elements of each array against each other, by
+    // rotating the block of b, and then advances the block with the smallest
+    // maximum (or both, if they are equal)
+    const size_t blocks_a = size_a & ~(size_t)3;
+    const size_t blocks_b = size_b & ~(size_t)3;
+    while ((i < blocks_a) && (j < blocks_b)) {
+        const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+        const __m128i matches = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0,3,2,1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1,0,3,2))), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2,1,0,3)))));
+        unsigned int mask = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(matches));
+        while (mask != 0) {
+            output[size++] = a[i + (size_t)__builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+        const uint32_t max_a = a[i + 3];
+        const uint32_t max_b = b[j + 3];
+        i += (max_a <= max_b) ? 4 : 0;
+        j += (max_b <= max_a) ? 4 : 0;
+    }
+#endif
+    while ((i < size_a) && (j < size_b)) {
+        if (a[i] == b[j]) {
+            output[size++] = a[i];
+        }
+        const uint32_t value_a = a[i];
+        const uint32_t value_b = b[j];
+        i += (value_a <= value_b);
+        j += (value_b <= value_a);
+    }
+    array_size(output) = size;
+    return output;
+}
+
+CDATA_FCN_DEF size_t djb2(const char *str) {
+    size_t hash = 5381;
+    for (; *str; ++str) {
+        /* hash * 33 + c */
+        hash = ((hash << 5) + hash) + (size_t)*str;
+    }
+    return hash;
+}
+
+// Same as djb2, for strings with the specified length
+CDATA_FCN_DEF size_t djb2n(const char *str, size_t length) {
+    size_t hash = 5381;
+    for (size_t i = 0; i < length; i++) {
+        hash = ((hash << 5) + hash) + (size_t)str[i];
+    }
+    return hash;
+}
+
+CDATA_FCN_DEF void *_hash_table_new(size_t element_size, Hash_Fcn hash_function, Compare_Fcn compare_key, size_t initial_capacity) {
+    size_t header_size = hash_table_header_size_from_capacity(initial_capacity);
+    void *hash_table = _array_resize(NULL, element_size, header_size, initial_capacity);
+    if (hash_table != NULL) {
+        hash_table_hash_function(hash_table) = hash_function;
+        hash_table_compare_function(hash_table) = compare_key;
+    }
+    return hash_table;
+}
+
+// This function returns the index of the key if it is present in the hash table.
+// If it is not present, the function returns the next non-occupied index (if there is one).
+CDATA_FCN_DEF size_t _hash_table_get_index(void *hash_table, size_t element_size, const void *key) {
+    size_t index = hash_table_compute_hash(hash_table, key);
+    size_t i = 0;
+    for (; i < hash_table_capacity(hash_table); i++) {
+        if (!hash_table_is_occupied(hash_table, index)) {
+            break;
+        }
+        void *it = hash_table_compute_address_at(hash_table,element_size,index);
+        if (hash_table_compare_keys(hash_table, it, key) == 0) {
+            break;
+        }
+#ifdef QUADRATIC_PROBING
+        index = (index + i*i) % hash_table_capacity(hash_table);
+#else // LINEAR_PROBING
+        index = (index + 1) % hash_table_capacity(hash_table);
+#endif
+    }
+    CDATA_STATS_ADD(hash_tables.lookups, 1);
+    CDATA_STATS_ADD(hash_tables.probes, i);
+    CDATA_STATS_ADD(hash_tables.probe_histogram[INT_MIN(i, (size_t)CDATA_STATS_PROBE_BUCKETS - 1)], 1);
+    if (i >= hash_table_capacity(hash_table)) {
+        // The table is full and the key wasn't found
+        return((size_t)-1);
+    }
+    return(index);
+}
+
+CDATA_FCN_DEF void *_hash_table_get(void *hash_table, size_t element_size, const void *key) {
+    size_t index = _hash_table_get_index(hash_table, element_size, key);
+    if (index >= hash_table_capacity(hash_table)) {
+        return(NULL);
+    }
+    if (hash_table_is_occupied(hash_table, index)) {
+        void *it = hash_table_compute_address_at(hash_table,element_size,index);
+        return(it);
+    }
+    return(NULL);
+}
+
+CDATA_FCN_DEF void *_hash_table_resize(void *hash_table, size_t element_size, size_t new_capacity) {
+#ifdef CDATA_STATS
+    const clock_t tic = clock();
+#endif
+    void *new_hash_table = _hash_table_new(element_size,
+        hash_table_hash_function(hash_table),
+        hash_table_compare_function(hash_table),
+        new_capacity);
+    if (new_hash_table == NULL) {
+        return(NULL);
+    }
+    for (size_t i = 0; i < hash_table_capacity(hash_table); i++) {
+        if (hash_table_is_occupied(hash_table, i)) {
+            // Insert every element from the old hash table into the new one
+            // OBS: the indexes may change
+            void *it = hash_table_compute_address_at(hash_table, element_size, i);
+            size_t index = _hash_table_get_index(new_hash_table, element_size, it);
+            void *address = hash_table_compute_address_at(new_hash_table, element_size, index);
+            CDATA_MEMCPY(address, it, element_size);
+            hash_table_set_occupied(new_hash_table, index);
+        }
+        hash_table_size(new_hash_table) = hash_table_size(hash_table);
+    }
+    hash_table_delete(hash_table);
+    CDATA_STATS_ADD(hash_tables.resizes, 1);
+    CDATA_STATS_ADD(hash_tables.resize_clocks, clock() - tic);
+    return(new_hash_table);
+}
+
+CDATA_FCN_DEF void *_hash_table_resize_if_needed(void *hash_table, size_t element_size) {
+    if (LOAD_FACTOR_DENOMINATOR*hash_table_size(hash_table) >= LOAD_FACTOR_NUMERATOR*hash_table_capacity(hash_table)) {
+        size_t new_capacity = GROWTH_FACTOR*hash_table_capacity(hash_table);
+        new_capacity = round_up_2(new_capacity);
+        hash_table = _hash_table_resize(hash_table, element_size, new_capacity);
+    }
+    return(hash_table);
+}
+
+CDATA_FCN_DEF int _hash_table_insert(void **hash_table, size_t element_size, const void *value, void **const user_address) {
+    *hash_table = _hash_table_resize_if_needed(*hash_table, element_size);
+    size_t index = _hash_table_get_index(*hash_table, element_size, value);
+    void *address = hash_table_compute_address_at(*hash_table, element_size, index);
+    if (hash_table_is_occupied(*hash_table, index)) {
+        // The element is already present in the hash table
+        if (user_address != NULL) {
+            *user_address = address;
+        }
+        return(0);
+    }
+    CDATA_MEMCPY(address, value, element_size);
+    hash_table_set_occupied(*hash_table, index);
+    hash_table_size(*hash_table)++;
+    if (user_address != NULL) {
+        *user_address = address;
+    }
+    return(1);
+}
+
+CDATA_FCN_DEF void *_hash_table_to_array(const void *hash_table, size_t element_size) {
+    void *array = _array_resize(NULL, element_size, ARRAY_HEADER_SIZE, hash_table_capacity(hash_table));
+    if (array == NULL) {
+        return(NULL);
+    }
+    for (size_t i = 0; i < hash_table_capacity(hash_table); i++) {
+        if (hash_table_is_occupied(hash_table, i)) {
+            void *it = hash_table_compute_address_at(hash_table, element_size, i);
+            array_push_raw(array,it,element_size);
+        }
+    }
+    return(array);
+}
+
+// Returns the offset inside the region where an allocation with the specified
+// alignment would start. It may be greater than the region capacity.
+CDATA_FCN_DEF size_t _arena_aligned_offset(const Region *region, size_t alignment) {
+    size_t address = (size_t)region->data + region->occupied;
+    size_t aligned = (address + alignment - 1) & ~(alignment - 1);
+    return region->occupied + (aligned - address);
+}
+
+CDATA_FCN_DEF int _arena_region_fits(const Region *region, size_t offset, size_t size) {
+    return (offset <= region->capacity) && (size <= region->capacity - offset);
+}
+
+// The regions after arena->current are always empty, so the allocation only
+// looks at the current region and at the next one, which keeps it O(1)
+CDATA_FCN_DEF void *arena_alloc_aligned(Arena *arena, size_t size, size_t alignment) {
+    CDATA_ASSERT((alignment != 0) && ((alignment & (alignment - 1)) == 0));
+    Region *current = arena->current;
+    if (current != NULL) {
+        size_t offset = _arena_aligned_offset(current, alignment);
+        if (_arena_region_fits(current, offset, size)) {
+            CDATA_STATS_ADD(arenas.allocations, 1);
+            CDATA_STATS_ADD(arenas.allocated_bytes, size);
+            current->occupied = offset + size;
+            return (void *)(current->data + offset);
+        }
+        CDATA_STATS_ADD(arenas.wasted_bytes, current->capacity - current->occupied);
+        Region *next = current->next;
+        if (next != NULL) {
+            next->occupied = 0;
+            offset = _arena_aligned_offset(next, alignment);
+            if (_arena_region_fits(next, offset, size)) {
+                CDATA_STATS_ADD(arenas.allocations, 1);
+                CDATA_STATS_ADD(arenas.allocated_bytes, size);
+                next->occupied = offset + size;
+                arena->current = next;
+                return (void *)(next->data + offset);
+            }
+        }
+    }
+    // Allocates a new region, bigger than the last one
+    size_t capacity = ARENA_DEFAULT_REGION_CAPACITY;
+    if (current != NULL) {
+        capacity = INT_MIN(GROWTH_FACTOR*current->capacity, (size_t)ARENA_MAX_REGION_CAPACITY);
+        capacity = INT_MAX(capacity, (size_t)ARENA_DEFAULT_REGION_CAPACITY);
+    }
+    capacity = INT_MAX(capacity, size + alignment - 1);
+    Region *new_region = CDATA_REALLOC(NULL, capacity + sizeof(Region));
+    if (new_region == NULL) {
+        return NULL;
+    }
+    CDATA_STATS_ADD(arenas.regions, 1);
+    CDATA_STATS_ADD(arenas.region_bytes, capacity);
+    CDATA_STATS_ADD(arenas.allocations, 1);
+    CDATA_STATS_ADD(arenas.allocated_bytes, size);
+    new_region->capacity = capacity;
+    new_region->occupied = 0;
+    // The new region is inserted right after the current one, so that the
+    // empty regions that follow it may still be reused later
+    if (current != NULL) {
+        new_region->next = current->next;
+        current->next = new_region;
+    } else {
+        new_region->next = arena->first;
+        arena->first = new_region;
+    }
+    arena->current = new_region;
+    size_t offset = _arena_aligned_offset(new_region, alignment);
+    new_region->occupied = offset + size;
+    return (void *)(new_region->data + offset);
+}
+
+CDATA_FCN_DEF void *arena_alloc(Arena *arena, size_t size) {
+    return arena_alloc_aligned(arena, size, ARENA_DEFAULT_ALIGNMENT);
+}
+
+CDATA_FCN_DEF void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (ptr == NULL) {
+        return arena_alloc(arena, new_size);
+    }
+    Region *current = arena->current;
+    if (current != NULL) {
+        size_t offset = (size_t)ptr - (size_t)current->data;
+        // Checks if ptr is the last allocation of the current region
+        if (((char *)ptr >= current->data) && (offset + old_size == current->occupied) &&
+            (new_size <= current->capacity - offset)) {
+            current->occupied = offset + new_size;
+            return ptr;
+        }
+    }
+    if (new_size <= old_size) {
+        return ptr;
+    }
+    void *new_ptr = arena_alloc(arena, new_size);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+    CDATA_MEMCPY(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+CDATA_FCN_DEF char *arena_strdup(Arena *arena, const char *str) {
+    size_t len = CDATA_STRLEN(str) + 1;
+    // Strings don't need any alignment, so they are tightly packed
+    char *dup = arena_alloc_aligned(arena, len, 1);
+    if (dup == NULL) {
+        return NULL;
+    }
+    CDATA_MEMCPY(dup, str, len);
+    return dup;
+}
+
+CDATA_FCN_DEF char *arena_strndup(Arena *arena, const char *str, size_t len) {
+    char *dup = arena_alloc_aligned(arena, len + 1, 1);
+    if (dup == NULL) {
+        return NULL;
+    }
+    CDATA_MEMCPY(dup, str, len);
+    dup[len] = '\0';
+    return dup;
+}
+
+// The regions are kept allocated, to be reused by the next allocations.
+// Only the first one needs to be cleared, as arena_alloc_aligned clears
+// the following ones when it moves to them.
+CDATA_FCN_DEF void arena_free_all(Arena *arena) {
+    arena->current = arena->first;
+    if (arena->first != NULL) {
+        arena->first->occupied = 0;
+    }
+}
+
+CDATA_FCN_DEF Arena_Snapshot arena_snapshot(const Arena *arena) {
+    Arena_Snapshot snapshot = {
+        .region = arena->current,
+        .occupied = (arena->current != NULL) ? arena->current->occupied : 0,
+    };
+    return snapshot;
+}
+
+// The snapshot is no longer valid after arena_free_all or after rewinding
+// to an older snapshot
+CDATA_FCN_DEF void arena_rewind(Arena *arena, Arena_Snapshot snapshot) {
+    if (snapshot.region == NULL) {
+        // The snapshot was taken when the arena was still empty
+        arena_free_all(arena);
+        return;
+    }
+    // The regions after the current one will be cleared when they are reused
+    arena->current = snapshot.region;
+    arena->current->occupied = snapshot.occupied;
+}
+
+CDATA_FCN_DEF Arena_Temp arena_temp_begin(Arena *arena) {
+    Arena_Temp temp = {
+        .arena = arena,
+        .snapshot = arena_snapshot(arena),
+    };
+    return temp;
+}
+
+CDATA_FCN_DEF void arena_temp_end(Arena_Temp temp) {
+    arena_rewind(temp.arena, temp.snapshot);
+}
+
+CDATA_FCN_DEF void arena_delete(Arena *arena) {
+    Region *region = arena->first;
+    while (region != NULL) {
+        Region *next = region->next;
+        CDATA_FREE(region);
+        region = next;
+    }
+    CDATA_MEMSET(arena, 0, sizeof(*arena));
+}
+
+CDATA_FCN_DEF void _shared_arena_push_region(Region **list, Region *region) {
+    Region *head = CDATA_ATOMIC_LOAD(list);
+    do {
+        CDATA_ATOMIC_STORE(&region->next, head);
+    } while (!CDATA_ATOMIC_CAS(list, &head, region));
+}
+
+// Regions are only pushed to the available list by shared_arena_free_all, while
+// no thread is allocating, so the ABA problem can't happen here
+CDATA_FCN_DEF Region *_shared_arena_pop_region(Region **list) {
+    Region *head = CDATA_ATOMIC_LOAD(list);
+    while (head != NULL) {
+        Region *next = CDATA_ATOMIC_LOAD(&head->next);
+        if (CDATA_ATOMIC_CAS(list, &head, next)) {
+            break;
+        }
+    }
+    return head;
+}
+
+CDATA_FCN_DEF Shared_Arena_Local shared_arena_local(Shared_Arena *shared) {
+    Shared_Arena_Local local = {
+        .shared = shared,
+        .current = NULL,
+        .generation = shared->generation,
+    };
+    return local;
+}
+
+CDATA_FCN_DEF void *shared_arena_alloc_aligned(Shared_Arena_Local *local, size_t size, size_t alignment) {
+    CDATA_ASSERT((alignment != 0) && ((alignment & (alignment - 1)) == 0));
+    Shared_Arena *shared = local->shared;
+    Region *current = local->current;
+    if (local->generation != shared->generation) {
+        // The arena was freed, so the current region was recycled
+        local->generation = shared->generation;
+        local->current = NULL;
+    } else if (current != NULL) {
+        size_t offset = _arena_aligned_offset(current, alignment);
+        if (_arena_region_fits(current, offset, size)) {
+            current->occupied = offset + size;
+            return (void *)(current->data + offset);
+        }
+    }
+    // Tries to reuse a recycled region
+    Region *region = _shared_arena_pop_region(&shared->available);
+    if (region != NULL) {
+        region->occupied = 0;
+        _shared_arena_push_region(&shared->regions, region);
+        size_t offset = _arena_aligned_offset(region, alignment);
+        if (_arena_region_fits(region, offset, size)) {
+            region->occupied = offset + size;
+            local->current = region;
+            return (void *)(region->data + offset);
+        }
+        // The recycled region is too small, it will be available again after
+        // the next call to shared_arena_free_all
+    }
+    // Allocates a new region, bigger than the last one used by this thread
+    size_t capacity = ARENA_DEFAULT_REGION_CAPACITY;
+    if (current != NULL) {
+        capacity = INT_MIN(GROWTH_FACTOR*current->capacity, (size_t)ARENA_MAX_REGION_CAPACITY);
+        capacity = INT_MAX(capacity, (size_t)ARENA_DEFAULT_REGION_CAPACITY);
+    }
+    capacity = INT_MAX(capacity, size + alignment - 1);
+    region = CDATA_REALLOC(NULL, capacity + sizeof(Region));
+    if (region == NULL) {
+        return NULL;
+    }
+    region->capacity = capacity;
+    region->occupied = 0;
+    _shared_arena_push_region(&shared->regions, region);
+    size_t offset = _arena_aligned_offset(region, alignment);
+    region->occupied = offset + size;
+    local->current = region;
+    return (void *)(region->data + offset);
+}
+
+CDATA_FCN_DEF void *shared_arena_alloc(Shared_Arena_Local *local, size_t size) {
+    return shared_arena_alloc_aligned(local, size, ARENA_DEFAULT_ALIGNMENT);
+}
+
+CDATA_FCN_DEF char *shared_arena_strdup(Shared_Arena_Local *local, const char *str) {
+    size_t len = CDATA_STRLEN(str) + 1;
+    char *dup = shared_arena_alloc_aligned(local, len, 1);
+    if (dup == NULL) {
+        return NULL;
+    }
+    CDATA_MEMCPY(dup, str, len);
+    return dup;
+}
+
+CDATA_FCN_DEF char *shared_arena_strndup(Shared_Arena_Local *local, const char *str, size_t len) {
+    char *dup = shared_arena_alloc_aligned(local, len + 1, 1);
+    if (dup == NULL) {
+        return NULL;
+    }
+    CDATA_MEMCPY(dup, str, len);
+    dup[len] = '\0';
+    return dup;
+}
+
+// Every region becomes available again. The Shared_Arena_Local of each thread
+// notices it through the generation counter, and drops its current region.
+CDATA_FCN_DEF void shared_arena_free_all(Shared_Arena *shared) {
+    Region *region = shared->regions;
+    if (region != NULL) {
+        while (region->next != NULL) {
+            region = region->next;
+        }
+        region->next = shared->available;
+        shared->available = shared->regions;
+        shared->regions = NULL;
+    }
+    shared->generation++;
+}
+
+CDATA_FCN_DEF void shared_arena_delete(Shared_Arena *shared) {
+    Region *lists[] = { shared->regions, shared->available };
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(lists); i++) {
+        Region *region = lists[i];
+        while (region != NULL) {
+            Region *next = region->next;
+            CDATA_FREE(region);
+            region = next;
+        }
+    }
+    shared->regions = NULL;
+    shared->available = NULL;
+    shared->generation++;
+}
+
+CDATA_FCN_DEF Pool _pool_new(size_t object_size, size_t block_size) {
+    // The objects are naturally aligned, as long as their size is a multiple of
+    // the size of a pointer and the block data is aligned like malloc does
+    object_size = INT_ROUND_UP(INT_MAX(object_size, sizeof(void *)), sizeof(void *));
+    size_t objects_per_block = 1;
+    if (block_size > sizeof(Pool_Block) + object_size) {
+        objects_per_block = (block_size - sizeof(Pool_Block)) / object_size;
+    }
+    Pool pool = {
+        .object_size = object_size,
+        .objects_per_block = objects_per_block,
+    };
+    return pool;
+}
+
+CDATA_FCN_DEF void *pool_alloc(Pool *pool) {
+    if (pool->free_list != NULL) {
+        void *object = pool->free_list;
+        pool->free_list = *(void **)object;
+        return object;
+    }
+    // Carves a new object from the current block
+    if ((pool->current == NULL) || (pool->used_in_current >= pool->objects_per_block)) {
+        // The blocks after the current one are empty (see pool_free_all)
+        if ((pool->current != NULL) && (pool->current->next != NULL)) {
+            pool->current = pool->current->next;
+        } else {
+            Pool_Block *block = CDATA_REALLOC(NULL, sizeof(Pool_Block) + pool->objects_per_block*pool->object_size);
+            if (block == NULL) {
+                return NULL;
+            }
+            block->next = NULL;
+            if (pool->current != NULL) {
+                pool->current->next = block;
+            } else {
+                pool->first = block;
+            }
+            pool->current = block;
+        }
+        pool->used_in_current = 0;
+    }
+    void *object = (char *)pool->current->data + pool->used_in_current*pool->object_size;
+    pool->used_in_current++;
+    return object;
+}
+
+CDATA_FCN_DEF void pool_free(Pool *pool, void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    *(void **)ptr = pool->free_list;
+    pool->free_list = ptr;
+}
+
+// The blocks are kept allocated, to be reused by the next allocations
+CDATA_FCN_DEF void pool_free_all(Pool *pool) {
+    pool->current = pool->first;
+    pool->used_in_current = 0;
+    pool->free_list = NULL;
+}
+
+CDATA_FCN_DEF void pool_delete(Pool *pool) {
+    Pool_Block *block = pool->first;
+    while (block != NULL) {
+        Pool_Block *next = block->next;
+        CDATA_FREE(block);
+        block = next;
+    }
+    pool->first = NULL;
+    pool->current = NULL;
+    pool->used_in_current = 0;
+    pool->free_list = NULL;
+}
+
+CDATA_FCN_DEF Pool_Cache pool_cache_new(Pool *pool) {
+    Pool_Cache cache = {
+        .pool = pool,
+        .free_list = NULL,
+        .count = 0,
+    };
+    return cache;
+}
+
+CDATA_FCN_DEF void *pool_cache_alloc(Pool_Cache *cache) {
+    if (cache->free_list == NULL) {
+        // Refills the cache with a batch of objects from the pool
+        spinlock_lock(&cache->pool->lock);
+        for (size_t i = 0; i < POOL_CACHE_BATCH; i++) {
+            void *object = pool_alloc(cache->pool);
+            if (object == NULL) {
+                break;
+            }
+            *(void **)object = cache->free_list;
+            cache->free_list = object;
+            cache->count++;
+        }
+        spinlock_unlock(&cache->pool->lock);
+        if (cache->free_list == NULL) {
+            return NULL;
+        }
+    }
+    void *object = cache->free_list;
+    cache->free_list = *(void **)object;
+    cache->count--;
+    return object;
+}
+
+CDATA_FCN_DEF void pool_cache_free(Pool_Cache *cache, void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    *(void **)ptr = cache->free_list;
+    cache->free_list = ptr;
+    cache->count++;
+    if (cache->count < 2*POOL_CACHE_BATCH) {
+        return;
+    }
+    // Gives a batch of objects back to the pool, so that other threads can use them
+    void *last = cache->free_list;
+    for (size_t i = 1; i < POOL_CACHE_BATCH; i++) {
+        last = *(void **)last;
+    }
+    void *remaining = *(void **)last;
+    spinlock_lock(&cache->pool->lock);
+    *(void **)last = cache->pool->free_list;
+    cache->pool->free_list = cache->free_list;
+    spinlock_unlock(&cache->pool->lock);
+    cache->free_list = remaining;
+    cache->count -= POOL_CACHE_BATCH;
+}
+
+CDATA_FCN_DEF void pool_cache_flush(Pool_Cache *cache) {
+    if (cache->free_list == NULL) {
+        return;
+    }
+    void *last = cache->free_list;
+    while (*(void **)last != NULL) {
+        last = *(void **)last;
+    }
+    spinlock_lock(&cache->pool->lock);
+    *(void **)last = cache->pool->free_list;
+    cache->pool->free_list = cache->free_list;
+    spinlock_unlock(&cache->pool->lock);
+    cache->free_list = NULL;
+    cache->count = 0;
+}
+
+CDATA_FCN_DEF Heavy_Hitters *_heavy_hitters_new(size_t element_size, Hash_Fcn hash_function, Compare_Fcn compare_key, size_t capacity) {
+    capacity = INT_MAX(capacity, (size_t)1);
+    // The index is kept at most half full
+    const size_t index_capacity = round_up_2(2*capacity);
+    const size_t arrays_length = (5*capacity + index_capacity)*sizeof(size_t);
+    Heavy_Hitters *heavy_hitters = CDATA_REALLOC(NULL, sizeof(Heavy_Hitters) + arrays_length + capacity*element_size);
+    if (heavy_hitters == NULL) {
+        return NULL;
+    }
+    size_t *arrays = (size_t *)(heavy_hitters + 1);
+    *heavy_hitters = (Heavy_Hitters) {
+        .element_size = element_size,
+        .capacity = capacity,
+        .hash_function = hash_function,
+        .compare_key = compare_key,
+        .counts = arrays,
+        .errors = arrays + capacity,
+        .hashes = arrays + 2*capacity,
+        .heap = arrays + 3*capacity,
+        .heap_position = arrays + 4*capacity,
+        .index = arrays + 5*capacity,
+        .index_capacity = index_capacity,
+        .elements = (char *)(arrays + 5*capacity + index_capacity),
+    };
+    CDATA_MEMSET(heavy_hitters->index, 0, index_capacity*sizeof(size_t));
+    return heavy_hitters;
+}
+
+// Returns the position of the value in the index, or the empty position where it should be inserted
+CDATA_FCN_DEF size_t _heavy_hitters_find(const Heavy_Hitters *heavy_hitters, const void *value, size_t hash) {
+    const size_t mask = heavy_hitters->index_capacity - 1;
+    size_t position = hash & mask;
+    while (heavy_hitters->index[position] != 0) {
+        const size_t i = heavy_hitters->index[position] - 1;
+        if ((heavy_hitters->hashes[i] == hash) &&
+            (heavy_hitters->compare_key(heavy_hitters_element_at(heavy_hitters, i), value) == 0)) {
+            break;
+        }
+        position = (position + 1) & mask;
+    }
+    return position;
+}
+
+// Removes an entry of the index, shifting back the following entries of the
+// probe sequence, so that no tombstones are needed
+CDATA_FCN_DEF void _heavy_hitters_remove_from_index(Heavy_Hitters *heavy_hitters, size_t position) {
+    const size_t mask = heavy_hitters->index_capacity - 1;
+    size_t next = position;
+    for (;;) {
+        next = (next + 1) & mask;
+        if (heavy_hitters->index[next] == 0) {
+            break;
+        }
+        const size_t home = heavy_hitters->hashes[heavy_hitters->index[next] - 1] & mask;
+        // Distance from the home of the entry, to the free position and to its current position
+        if (((position - home) & mask) < ((next - home) & mask)) {
+            heavy_hitters->index[position] = heavy_hitters->index[next];
+            position = next;
+        }
+    }
+    heavy_hitters->index[position] = 0;
+}
+
+CDATA_FCN_DEF void _heavy_hitters_sift_up(Heavy_Hitters *heavy_hitters, size_t position) {
+    size_t *const heap = heavy_hitters->heap;
+    const size_t *const counts = heavy_hitters->counts;
+    const size_t element = heap[position];
+    while (position > 0) {
+        const size_t parent = (position - 1)/2;
+        if (counts[heap[parent]] <= counts[element]) {
+            break;
+        }
+        heap[position] = heap[parent];
+        heavy_hitters->heap_position[heap[position]] = position;
+        position = parent;
+    }
+    heap[position] = element;
+    heavy_hitters->heap_position[element] = position;
+}
+
+CDATA_FCN_DEF void _heavy_hitters_sift_down(Heavy_Hitters *heavy_hitters, size_t position) {
+    size_t *const heap = heavy_hitters->heap;
+    const size_t *const counts = heavy_hitters->counts;
+    const size_t element = heap[position];
+    for (;;) {
+        size_t child = 2*position + 1;
+        if (child >= heavy_hitters->size) {
+            break;
+        }
+        if ((child + 1 < heavy_hitters->size) && (counts[heap[child + 1]] < counts[heap[child]])) {
+            child++;
+        }
+        if (counts[heap[child]] >= counts[element]) {
+            break;
+        }
+        heap[position] = heap[child];
+        heavy_hitters->heap_position[heap[position]] = position;
+        position = child;
+    }
+    heap[position] = element;
+    heavy_hitters->heap_position[element] = position;
+}
+
+// Mixes the bits of the hash, since the index uses only the lowest ones
+#define _heavy_hitters_hash(heavy_hitters,value) \
+    ((heavy_hitters)->hash_function(value) * (size_t)0x9E3779B97F4A7C15ULL >> 16)
+
+CDATA_FCN_DEF int _heavy_hitters_add(Heavy_Hitters *heavy_hitters, const void *value, size_t count, void **const user_address) {
+    const size_t hash = _heavy_hitters_hash(heavy_hitters, value);
+    size_t position = _heavy_hitters_find(heavy_hitters, value, hash);
+    heavy_hitters->total += count;
+    size_t i;
+    int inserted = 0;
+    if (heavy_hitters->index[position] != 0) {
+        i = heavy_hitters->index[position] - 1;
+        heavy_hitters->counts[i] += count;
+    } else {
+        inserted = 1;
+        size_t min_count = 0;
+        if (heavy_hitters->size < heavy_hitters->capacity) {
+            i = heavy_hitters->size++;
+            heavy_hitters->heap[i] = i;
+            heavy_hitters->heap_position[i] = i;
+        } else {
+            // Replaces the least frequent element, which inherits its count as error
+            i = heavy_hitters->heap[0];
+            min_count = heavy_hitters->counts[i];
+            size_t old_position = _heavy_hitters_find(heavy_hitters, heavy_hitters_element_at(heavy_hitters, i), heavy_hitters->hashes[i]);
+            _heavy_hitters_remove_from_index(heavy_hitters, old_position);
+            position = _heavy_hitters_find(heavy_hitters, value, hash);
+        }
+        CDATA_MEMCPY(heavy_hitters_element_at(heavy_hitters, i), value, heavy_hitters->element_size);
+        heavy_hitters->hashes[i] = hash;
+        heavy_hitters->counts[i] = min_count + count;
+        heavy_hitters->errors[i] = min_count;
+        heavy_hitters->index[position] = i + 1;
+        // A new element is appended at the end of the heap
+        _heavy_hitters_sift_up(heavy_hitters, heavy_hitters->heap_position[i]);
+    }
+    // The count only grows, so the element can only move down in the min-heap
+    _heavy_hitters_sift_down(heavy_hitters, heavy_hitters->heap_position[i]);
+    if (user_address != NULL) {
+        *user_address = heavy_hitters_element_at(heavy_hitters, i);
+    }
+    return inserted;
+}
+
+CDATA_FCN_DEF size_t heavy_hitters_count(const Heavy_Hitters *heavy_hitters, const void *value) {
+    const size_t hash = _heavy_hitters_hash(heavy_hitters, value);
+    const size_t position = _heavy_hitters_find(heavy_hitters, value, hash);
+    if (heavy_hitters->index[position] == 0) {
+        return 0;
+    }
+    return heavy_hitters->counts[heavy_hitters->index[position] - 1];
+}
+
+CDATA_FCN_DEF size_t *heavy_hitters_sorted_indexes(const Heavy_Hitters *heavy_hitters) {
+    size_t *indexes = NULL;
+    if (heavy_hitters->size == 0) {
+        return NULL;
+    }
+    indexes = _array_resize_if_needed(NULL, sizeof(size_t), heavy_hitters->size);
+    if (indexes == NULL) {
+        return NULL;
+    }
+    // Heap sort, since it doesn't need a comparison function with access to the
+    // counts: the min-heap is copied, and its minimum is moved to the end repeatedly
+    const size_t *const counts = heavy_hitters->counts;
+    const size_t size = heavy_hitters->size;
+    CDATA_MEMCPY(indexes, heavy_hitters->heap, size*sizeof(size_t));
+    for (size_t end = size - 1; end > 0; end--) {
+        const size_t element = indexes[end];
+        indexes[end] = indexes[0];
+        size_t position = 0;
+        for (;;) {
+            size_t child = 2*position + 1;
+            if (child >= end) {
+                break;
+            }
+            if ((child + 1 < end) && (counts[indexes[child + 1]] < counts[indexes[child]])) {
+                child++;
+            }
+            if (counts[indexes[child]] >= counts[element]) {
+                break;
+            }
+            indexes[position] = indexes[child];
+            position = child;
+        }
+        indexes[position] = element;
+    }
+    array_size(indexes) = size;
+    return indexes;
+}
+
+#define _radix_tree_is_leaf(child)          (((size_t)(child)) & 1)
+#define _radix_tree_to_leaf(child)          ((Radix_Leaf *)((size_t)(child) & ~(size_t)1))
+#define _radix_tree_from_leaf(leaf)         ((void *)((size_t)(leaf) | 1))
+#define _radix_tree_leaf_value(leaf)        ((void *)((char *)(leaf) + sizeof(Radix_Leaf)))
+#define _radix_tree_leaf_key(tree,leaf)     ((unsigned char *)_radix_tree_leaf_value(leaf) + (tree)->value_size)
+
+CDATA_FCN_DEF Radix_Tree _radix_tree_new(size_t value_size, Arena *arena) {
+    // The leaves are tagged through the lowest bit of their addresses
+    CDATA_ASSERT(ARENA_DEFAULT_ALIGNMENT >= 2);
+    Radix_Tree tree = { 0 };
+    tree.arena = arena;
+    tree.value_size = INT_ROUND_UP(value_size, ARENA_DEFAULT_ALIGNMENT);
+    return tree;
+}
+
+// Returns the length of the common prefix of a and b
+CDATA_FCN_DEF size_t _radix_tree_mismatch(const unsigned char *a, const unsigned char *b, size_t length) {
+    size_t i = 0;
+    while ((i < length) && (a[i] == b[i])) {
+        i++;
+    }
+    return i;
+}
+
+CDATA_FCN_DEF Radix_Leaf *_radix_tree_new_leaf(Radix_Tree *tree, const unsigned char *key, size_t length) {
+    Radix_Leaf *leaf = arena_alloc_aligned(tree->arena, sizeof(Radix_Leaf) + tree->value_size + length + 1, ARENA_DEFAULT_ALIGNMENT);
+    if (leaf == NULL) {
+        return NULL;
+    }
+    leaf->key_length = length;
+    CDATA_MEMSET(_radix_tree_leaf_value(leaf), 0, tree->value_size);
+    unsigned char *leaf_key = _radix_tree_leaf_key(tree, leaf);
+    CDATA_MEMCPY(leaf_key, key, length);
+    leaf_key[length] = '\0';
+    return leaf;
+}
+
+CDATA_FCN_DEF Radix_Node *_radix_tree_new_node(Radix_Tree *tree, Radix_Node_Type type) {
+    size_t size = 0;
+    switch (type) {
+    case RADIX_NODE4:   size = sizeof(Radix_Node4); break;
+    case RADIX_NODE16:  size = sizeof(Radix_Node16); break;
+    case RADIX_NODE48:  size = sizeof(Radix_Node48); break;
+    case RADIX_NODE256: size = sizeof(Radix_Node256); break;
+    }
+    Radix_Node *node = NULL;
+    if ((type < RADIX_NODE256) && (tree->free_nodes[type] != NULL)) {
+        // The free nodes are linked through their header
+        node = tree->free_nodes[type];
+        tree->free_nodes[type] = (Radix_Node *)node->leaf;
+    } else {
+        node = arena_alloc_aligned(tree->arena, size, ARENA_DEFAULT_ALIGNMENT);
+        if (node == NULL) {
+            return NULL;
+        }
+    }
+    CDATA_MEMSET(node, 0, size);
+    node->type = (unsigned char)type;
+    return node;
+}
+
+CDATA_FCN_DEF void **_radix_tree_find_child(Radix_Node *node, unsigned char byte) {
+    switch ((Radix_Node_Type)node->type) {
+    case RADIX_NODE4: {
+        Radix_Node4 *n = (Radix_Node4 *)node;
+        for (size_t i = 0; i < node->count; i++) {
+            if (n->keys[i] == byte) {
+                return &n->children[i];
+            }
+        }
+    } break;
+    case RADIX_NODE16: {
+        Radix_Node16 *n = (Radix_Node16 *)node;
+#ifdef CDATA_SSE2_SUPPORTED
+        // Compares the byte with all the keys at once
+        const __m128i matches = _mm_cmpeq_epi8(_mm_set1_epi8((char)byte), _mm_loadu_si128((const __m128i *)n->keys));
+        const unsigned int mask = (unsigned int)_mm_movemask_epi8(matches) & ((1U << node->count) - 1);
+        if (mask != 0) {
+            return &n->children[__builtin_ctz(mask)];
+        }
+#else
+        for (size_t i = 0; i < node->count; i++) {
+            if (n->keys[i] == byte) {
+                return &n->children[i];
+            }
+        }
+#endif
+    } break;
+    case RADIX_NODE48: {
+        Radix_Node48 *n = (Radix_Node48 *)node;
+        if (n->index[byte] != 0) {
+            return &n->children[n->index[byte] - 1];
+        }
+    } break;
+    case RADIX_NODE256: {
+        Radix_Node256 *n = (Radix_Node256 *)node;
+        if (n->children[byte] != NULL) {
+            return &n->children[byte];
+        }
+    } break;
+    }
+    return NULL;
+}
+
+// Adds a child to the node pointed by reference, replacing it by a bigger
+// node if it is full. Returns -1 if the allocation failed.
+CDATA_FCN_DEF int _radix_tree_add_child(Radix_Tree *tree, void **reference, unsigned char byte, void *child) {
+    Radix_Node *node = *reference;
+    switch ((Radix_Node_Type)node->type) {
+    case RADIX_NODE4:
+    case RADIX_NODE16: {
+        const int is_node4 = (node->type == RADIX_NODE4);
+        unsigned char *keys = is_node4 ? ((Radix_Node4 *)node)->keys : ((Radix_Node16 *)node)->keys;
+        void **children = is_node4 ? ((Radix_Node4 *)node)->children : ((Radix_Node16 *)node)->children;
+        const size_t capacity = is_node4 ? STATIC_ARRAY_SIZE(((Radix_Node4 *)node)->keys) : STATIC_ARRAY_SIZE(((Radix_Node16 *)node)->keys);
+        if (node->count < capacity) {
+            // Keeps the keys sorted, for the ordered iteration
+            size_t i = 0;
+            while ((i < node->count) && (keys[i] < byte)) {
+                i++;
+            }
+            CDATA_MEMMOVE(&keys[i + 1], &keys[i], (node->count - i)*sizeof(keys[0]));
+            CDATA_MEMMOVE(&children[i + 1], &children[i], (node->count - i)*sizeof(children[0]));
+            keys[i] = byte;
+            children[i] = child;
+            node->count++;
+            return 0;
+        }
+        Radix_Node *bigger = _radix_tree_new_node(tree, is_node4 ? RADIX_NODE16 : RADIX_NODE48);
+        if (bigger == NULL) {
+            return -1;
+        }
+        if (is_node4) {
+            Radix_Node16 *n = (Radix_Node16 *)bigger;
+            CDATA_MEMCPY(n->keys, keys, capacity*sizeof(keys[0]));
+            CDATA_MEMCPY(n->children, children, capacity*sizeof(children[0]));
+        } else {
+            Radix_Node48 *n = (Radix_Node48 *)bigger;
+            for (size_t i = 0; i < capacity; i++) {
+                n->index[keys[i]] = (unsigned char)(i + 1);
+                n->children[i] = children[i];
+            }
+        }
+        bigger->prefix = node->prefix;
+        bigger->prefix_length = node->prefix_length;
+        bigger->leaf = node->leaf;
+        bigger->count = node->count;
+        node->leaf = (Radix_Leaf *)tree->free_nodes[node->type];
+        tree->free_nodes[node->type] = node;
+        *reference = bigger;
+        return _radix_tree_add_child(tree, reference, byte, child);
+    }
+    case RADIX_NODE48: {
+        Radix_Node48 *n = (Radix_Node48 *)node;
+        if (node->count < STATIC_ARRAY_SIZE(n->children)) {
+            // There are no deletions, so the children are kept contiguous
+            n->children[node->count] = child;
+            n->index[byte] = (unsigned char)(node->count + 1);
+            node->count++;
+            return 0;
+        }
+        Radix_Node256 *bigger = (Radix_Node256 *)_radix_tree_new_node(tree, RADIX_NODE256);
+        if (bigger == NULL) {
+            return -1;
+        }
+        for (size_t i = 0; i < STATIC_ARRAY_SIZE(n->index); i++) {
+            if (n->index[i] != 0) {
+                bigger->children[i] = n->children[n->index[i] - 1];
+            }
+        }
+        bigger->node.prefix = node->prefix;
+        bigger->node.prefix_length = node->prefix_length;
+        bigger->node.leaf = node->leaf;
+        bigger->node.count = node->count;
+        node->leaf = (Radix_Leaf *)tree->free_nodes[RADIX_NODE48];
+        tree->free_nodes[RADIX_NODE48] = node;
+        *reference = bigger;
+        return _radix_tree_add_child(tree, reference, byte, child);
+    }
+    case RADIX_NODE256: {
+        Radix_Node256 *n = (Radix_Node256 *)node;
+        n->children[byte] = child;
+        node->count++;
+        return 0;
+    }
+    }
+    return -1;
+}
+
+CDATA_FCN_DEF int _radix_tree_insert(Radix_Tree *tree, const char *key, size_t length, void **const user_address) {
+    const unsigned char *bytes = (const unsigned char *)key;
+    void **reference = &tree->root;
+    size_t depth = 0;
+    for (;;) {
+        void *child = *reference;
+        if (child == NULL) {
+            Radix_Leaf *leaf = _radix_tree_new_leaf(tree, bytes, length);
+            if (leaf == NULL) {
+                return -1;
+            }
+            *reference = _radix_tree_from_leaf(leaf);
+            tree->size++;
+            if (user_address != NULL) {
+                *user_address = _radix_tree_leaf_value(leaf);
+            }
+            return 1;
+        }
+        if (_radix_tree_is_leaf(child)) {
+            Radix_Leaf *old_leaf = _radix_tree_to_leaf(child);
+            const unsigned char *old_key = _radix_tree_leaf_key(tree, old_leaf);
+            const size_t common = _radix_tree_mismatch(old_key + depth, bytes + depth, INT_MIN(old_leaf->key_length, length) - depth);
+            if ((old_leaf->key_length == length) && (depth + common == length)) {
+                // The key is already present
+                if (user_address != NULL) {
+                    *user_address = _radix_tree_leaf_value(old_leaf);
+                }
+                return 0;
+            }
+            // Replaces the leaf by a node with both leaves below it
+            Radix_Node *node = _radix_tree_new_node(tree, RADIX_NODE4);
+            Radix_Leaf *leaf = (node != NULL) ? _radix_tree_new_leaf(tree, bytes, length) : NULL;
+            if (leaf == NULL) {
+                return -1;
+            }
+            node->prefix = old_key + depth;
+            node->prefix_length = common;
+            depth += common;
+            void *replacement = node;
+            int status = 0;
+            if (old_leaf->key_length == depth) {
+                node->leaf = old_leaf;
+            } else {
+                status = _radix_tree_add_child(tree, &replacement, old_key[depth], child);
+            }
+            if (length == depth) {
+                node->leaf = leaf;
+            } else if (status == 0) {
+                status = _radix_tree_add_child(tree, &replacement, bytes[depth], _radix_tree_from_leaf(leaf));
+            }
+            *reference = replacement;
+            if (status != 0) {
+                return -1;
+            }
+            tree->size++;
+            if (user_address != NULL) {
+                *user_address = _radix_tree_leaf_value(leaf);
+            }
+            return 1;
+        }
+        Radix_Node *node = child;
+        if (node->prefix_length > 0) {
+            const size_t common = _radix_tree_mismatch(node->prefix, bytes + depth, INT_MIN(node->prefix_length, length - depth));
+            if (common < node->prefix_length) {
+                // Splits the prefix of the node
+                Radix_Node *parent = _radix_tree_new_node(tree, RADIX_NODE4);
+                Radix_Leaf *leaf = (parent != NULL) ? _radix_tree_new_leaf(tree, bytes, length) : NULL;
+                if (leaf == NULL) {
+                    return -1;
+                }
+                parent->prefix = node->prefix;
+                parent->prefix_length = common;
+                void *replacement = parent;
+                int status = _radix_tree_add_child(tree, &replacement, node->prefix[common], node);
+                node->prefix += common + 1;
+                node->prefix_length -= common + 1;
+                depth += common;
+                if (length == depth) {
+                    parent->leaf = leaf;
+                } else if (status == 0) {
+                    status = _radix_tree_add_child(tree, &replacement, bytes[depth], _radix_tree_from_leaf(leaf));
+                }
+                *reference = replacement;
+                if (status != 0) {
+                    return -1;
+                }
+                tree->size++;
+                if (user_address != NULL) {
+                    *user_address = _radix_tree_leaf_value(leaf);
+                }
+                return 1;
+            }
+            depth += node->prefix_length;
+        }
+        if (depth == length) {
+            const int inserted = (node->leaf == NULL);
+            if (inserted) {
+                node->leaf = _radix_tree_new_leaf(tree, bytes, length);
+                if (node->leaf == NULL) {
+                    return -1;
+                }
+                tree->size++;
+            }
+            if (user_address != NULL) {
+                *user_address = _radix_tree_leaf_value(node->leaf);
+            }
+            return inserted;
+        }
+        void **next = _radix_tree_find_child(node, bytes[depth]);
+        if (next == NULL) {
+            Radix_Leaf *leaf = _radix_tree_new_leaf(tree, bytes, length);
+            if ((leaf == NULL) || (_radix_tree_add_child(tree, reference, bytes[depth], _radix_tree_from_leaf(leaf)) != 0)) {
+                return -1;
+            }
+            // Counted only once the leaf is linked, since growing the node may fail
+            tree->size++;
+            if (user_address != NULL) {
+                *user_address = _radix_tree_leaf_value(leaf);
+            }
+            return 1;
+        }
+        reference = next;
+        depth++;
+    }
+}
+
+CDATA_FCN_DEF void *radix_tree_get(const Radix_Tree *tree, const char *key, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)key;
+    void *child = tree->root;
+    size_t depth = 0;
+    while (child != NULL) {
+        if (_radix_tree_is_leaf(child)) {
+            Radix_Leaf *leaf = _radix_tree_to_leaf(child);
+            if ((leaf->key_length != length) || (_radix_tree_mismatch(_radix_tree_leaf_key(tree, leaf), bytes, length) != length)) {
+                return NULL;
+            }
+            return _radix_tree_leaf_value(leaf);
+        }
+        Radix_Node *node = child;
+        if ((length - depth < node->prefix_length) || (_radix_tree_mismatch(node->prefix, bytes + depth, node->prefix_length) != node->prefix_length)) {
+            return NULL;
+        }
+        depth += node->prefix_length;
+        if (depth == length) {
+            return (node->leaf != NULL) ? _radix_tree_leaf_value(node->leaf) : NULL;
+        }
+        void **next = _radix_tree_find_child(node, bytes[depth]);
+        if (next == NULL) {
+            return NULL;
+        }
+        child = *next;
+        depth++;
+    }
+    return NULL;
+}
+
+// Visits the subtree in order: the key which ends at a node comes before the
+// keys of its children, which are sorted by their next byte
+CDATA_FCN_DEF int _radix_tree_visit(const Radix_Tree *tree, const void *child, Radix_Tree_Fcn fcn, void *context) {
+    if (child == NULL) {
+        return 0;
+    }
+    if (_radix_tree_is_leaf(child)) {
+        Radix_Leaf *leaf = _radix_tree_to_leaf(child);
+        return fcn(context, (const char *)_radix_tree_leaf_key(tree, leaf), leaf->key_length, _radix_tree_leaf_value(leaf));
+    }
+    const Radix_Node *node = child;
+    int result = 0;
+    if (node->leaf != NULL) {
+        result = _radix_tree_visit(tree, _radix_tree_from_leaf(node->leaf), fcn, context);
+    }
+    switch ((Radix_Node_Type)node->type) {
+    case RADIX_NODE4: {
+        const Radix_Node4 *n = (const Radix_Node4 *)node;
+        for (size_t i = 0; (result == 0) && (i < node->count); i++) {
+            result = _radix_tree_visit(tree, n->children[i], fcn, context);
+        }
+    } break;
+    case RADIX_NODE16: {
+        const Radix_Node16 *n = (const Radix_Node16 *)node;
+        for (size_t i = 0; (result == 0) && (i < node->count); i++) {
+            result = _radix_tree_visit(tree, n->children[i], fcn, context);
+        }
+    } break;
+    case RADIX_NODE48: {
+        const Radix_Node48 *n = (const Radix_Node48 *)node;
+        for (size_t i = 0; (result == 0) && (i < STATIC_ARRAY_SIZE(n->index)); i++) {
+            if (n->index[i] != 0) {
+                result = _radix_tree_visit(tree, n->children[n->index[i] - 1], fcn, context);
+            }
+        }
+    } break;
+    case RADIX_NODE256: {
+        const Radix_Node256 *n = (const Radix_Node256 *)node;
+        for (size_t i = 0; (result == 0) && (i < STATIC_ARRAY_SIZE(n->children)); i++) {
+            result = _radix_tree_visit(tree, n->children[i], fcn, context);
+        }
+    } break;
+    }
+    return result;
+}
+
+CDATA_FCN_DEF int radix_tree_for_each_prefix(const Radix_Tree *tree, const char *prefix, size_t length, Radix_Tree_Fcn fcn, void *context) {
+    const unsigned char *bytes = (const unsigned char *)prefix;
+    void *child = tree->root;
+    size_t depth = 0;
+    // Looks for the subtree whose keys start with the prefix
+    while ((child != NULL) && (depth < length)) {
+        if (_radix_tree_is_leaf(child)) {
+            Radix_Leaf *leaf = _radix_tree_to_leaf(child);
+            if ((leaf->key_length < length) || (_radix_tree_mismatch(_radix_tree_leaf_key(tree, leaf) + depth, bytes + depth, length - depth) != length - depth)) {
+                return 0;
+            }
+            break;
+        }
+        Radix_Node *node = child;
+        const size_t remaining = INT_MIN(node->prefix_length, length - depth);
+        if (_radix_tree_mismatch(node->prefix, bytes + depth, remaining) != remaining) {
+            return 0;
+        }
+        depth += node->prefix_length;
+        if (depth >= length) {
+            break;
+        }
+        void **next = _radix_tree_find_child(node, bytes[depth]);
+        if (next == NULL) {
+            return 0;
+        }
+        child = *next;
+        depth++;
+    }
+    return _radix_tree_visit(tree, child, fcn, context);
+}
+
+CDATA_FCN_DEF Btree _btree_new(size_t element_size, Compare_Fcn compare) {
+    Btree tree = { 0 };
+    tree.element_size = element_size;
+    tree.compare = compare;
+    // The nodes grow beyond BTREE_NODE_SIZE if it can't hold at least
+    // BTREE_MIN_CAPACITY elements
+    const size_t min_size = sizeof(Btree_Node) + BTREE_MIN_CAPACITY*(element_size + sizeof(Btree_Node *)) + sizeof(Btree_Node *);
+    tree.node_size = INT_MAX((size_t)BTREE_NODE_SIZE, INT_ROUND_UP(min_size, (size_t)CDATA_CACHE_LINE_SIZE));
+    tree.leaf_capacity = (tree.node_size - sizeof(Btree_Node)) / element_size;
+    tree.inner_capacity = (tree.node_size - sizeof(Btree_Node) - sizeof(Btree_Node *)) / (element_size + sizeof(Btree_Node *));
+    return tree;
+}
+
+CDATA_FCN_DEF void btree_delete(Btree *tree) {
+    arena_delete(&tree->arena);
+    tree->size = 0;
+    tree->height = 0;
+    tree->root = NULL;
+    tree->first = NULL;
+    tree->free_nodes = NULL;
+    tree->scratch = NULL;
+}
+
+// Returns the position of the first element not less than key
+CDATA_FCN_DEF size_t _btree_search(const Btree *tree, const char *elements, size_t count, const void *key, int *found) {
+    size_t low = 0;
+    size_t high = count;
+    *found = 0;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        const int result = tree->compare(elements + middle*tree->element_size, key);
+        if (result < 0) {
+            low = middle + 1;
+        } else {
+            *found = (result == 0);
+            high = middle;
+        }
+    }
+    return low;
+}
+
+CDATA_FCN_DEF Btree_Node *_btree_new_node(Btree *tree) {
+    Btree_Node *node = tree->free_nodes;
+    if (node != NULL) {
+        tree->free_nodes = node->next;
+    } else {
+        node = arena_alloc_aligned(&tree->arena, tree->node_size, CDATA_CACHE_LINE_SIZE);
+        if (node == NULL) {
+            return NULL;
+        }
+    }
+    node->count = 0;
+    node->next = NULL;
+    return node;
+}
+
+#define _btree_free_node(tree,node) \
+    ((node)->next = (tree)->free_nodes, (tree)->free_nodes = (node))
+
+// Makes sure that the next allocations of nodes won't fail, so that the tree
+// is never left in an inconsistent state
+CDATA_FCN_DEF int _btree_reserve(Btree *tree, size_t number_of_nodes) {
+    size_t available = 0;
+    for (Btree_Node *node = tree->free_nodes; (node != NULL) && (available < number_of_nodes); node = node->next) {
+        available++;
+    }
+    for (; available < number_of_nodes; available++) {
+        Btree_Node *node = arena_alloc_aligned(&tree->arena, tree->node_size, CDATA_CACHE_LINE_SIZE);
+        if (node == NULL) {
+            return -1;
+        }
+        _btree_free_node(tree, node);
+    }
+    if (tree->scratch == NULL) {
+        tree->scratch = arena_alloc(&tree->arena, 2*tree->element_size);
+        if (tree->scratch == NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Inserts the key at the position, with the child at its right
+CDATA_FCN_DEF void _btree_insert_key(Btree *tree, Btree_Node *node, size_t position, const void *key, Btree_Node *child) {
+    Btree_Node **children = _btree_children(node);
+    CDATA_MEMMOVE(_btree_key_at(tree, node, position + 1), _btree_key_at(tree, node, position), (node->count - position)*tree->element_size);
+    CDATA_MEMMOVE(&children[position + 2], &children[position + 1], (node->count - position)*sizeof(Btree_Node *));
+    CDATA_MEMCPY(_btree_key_at(tree, node, position), key, tree->element_size);
+    children[position + 1] = child;
+    node->count++;
+}
+
+CDATA_FCN_DEF int _btree_insert(Btree *tree, const void *value, void **const user_address) {
+    Btree_Node *path[BTREE_MAX_HEIGHT];
+    size_t positions[BTREE_MAX_HEIGHT];
+    if (tree->root == NULL) {
+        if (_btree_reserve(tree, 1) != 0) {
+            return -1;
+        }
+        tree->root = tree->first = _btree_new_node(tree);
+        tree->height = 1;
+    }
+    // Looks for the leaf, counting the full nodes that will be split
+    Btree_Node *node = tree->root;
+    size_t splits = 0;
+    for (size_t level = 0; level + 1 < tree->height; level++) {
+        int found = 0;
+        const size_t position = _btree_search(tree, _btree_key_at(tree, node, 0), node->count, value, &found) + (size_t)found;
+        splits = (node->count < tree->inner_capacity) ? 0 : splits + 1;
+        path[level] = node;
+        positions[level] = position;
+        node = _btree_children(node)[position];
+    }
+    int found = 0;
+    size_t index = _btree_search(tree, _btree_element_at(tree, node, 0), node->count, value, &found);
+    if (found) {
+        if (user_address != NULL) {
+            *user_address = _btree_element_at(tree, node, index);
+        }
+        return 0;
+    }
+    splits = (node->count < tree->leaf_capacity) ? 0 : splits + 1;
+    // If every node in the path splits, a new root is also needed
+    if (_btree_reserve(tree, splits + (splits == tree->height)) != 0) {
+        return -1;
+    }
+    tree->size++;
+    if (node->count < tree->leaf_capacity) {
+        char *address = _btree_element_at(tree, node, index);
+        CDATA_MEMMOVE(address + tree->element_size, address, (node->count - index)*tree->element_size);
+        CDATA_MEMCPY(address, value, tree->element_size);
+        node->count++;
+        if (user_address != NULL) {
+            *user_address = address;
+        }
+        return 1;
+    }
+    // Splits the leaf, keeping half of the elements in each one
+    Btree_Node *right = _btree_new_node(tree);
+    const size_t half = (tree->leaf_capacity + 1) / 2;
+    Btree_Node *destination = node;
+    if (index < half) {
+        node->count = half - 1;
+    } else {
+        node->count = half;
+        destination = right;
+        index -= half;
+    }
+    right->count = tree->leaf_capacity - node->count;
+    CDATA_MEMCPY(_btree_element_at(tree, right, 0), _btree_element_at(tree, node, node->count), right->count*tree->element_size);
+    char *address = _btree_element_at(tree, destination, index);
+    CDATA_MEMMOVE(address + tree->element_size, address, (destination->count - index)*tree->element_size);
+    CDATA_MEMCPY(address, value, tree->element_size);
+    destination->count++;
+    right->next = node->next;
+    node->next = right;
+    if (user_address != NULL) {
+        *user_address = address;
+    }
+    // Inserts the separators in the parents, splitting them when they are full
+    char *separator = tree->scratch;
+    char *promoted = tree->scratch + tree->element_size;
+    CDATA_MEMCPY(separator, _btree_element_at(tree, right, 0), tree->element_size);
+    Btree_Node *child = right;
+    for (size_t level = tree->height - 1; child != NULL; level--) {
+        if (level == 0) {
+            Btree_Node *root = _btree_new_node(tree);
+            _btree_children(root)[0] = tree->root;
+            root->count = 0;
+            _btree_insert_key(tree, root, 0, separator, child);
+            tree->root = root;
+            tree->height++;
+            break;
+        }
+        Btree_Node *parent = path[level - 1];
+        const size_t position = positions[level - 1];
+        if (parent->count < tree->inner_capacity) {
+            _btree_insert_key(tree, parent, position, separator, child);
+            break;
+        }
+        // The key in the middle moves up to the next level
+        Btree_Node *sibling = _btree_new_node(tree);
+        const size_t middle = tree->inner_capacity / 2;
+        sibling->count = tree->inner_capacity - middle - 1;
+        CDATA_MEMCPY(promoted, _btree_key_at(tree, parent, middle), tree->element_size);
+        CDATA_MEMCPY(_btree_key_at(tree, sibling, 0), _btree_key_at(tree, parent, middle + 1), sibling->count*tree->element_size);
+        CDATA_MEMCPY(_btree_children(sibling), &_btree_children(parent)[middle + 1], (sibling->count + 1)*sizeof(Btree_Node *));
+        parent->count = middle;
+        if (position <= middle) {
+            _btree_insert_key(tree, parent, position, separator, child);
+        } else {
+            _btree_insert_key(tree, sibling, position - middle - 1, separator, child);
+        }
+        CDATA_MEMCPY(separator, promoted, tree->element_size);
+        child = sibling;
+    }
+    return 1;
+}
+
+// Fixes the child at the position of the parent, which has less elements than
+// the minimum, by moving one element from a sibling, or by merging it with one
+CDATA_FCN_DEF void _btree_rebalance(Btree *tree, Btree_Node *parent, size_t position, int is_leaf) {
+    const size_t element_size = tree->element_size;
+    const size_t minimum = (is_leaf ? tree->leaf_capacity : tree->inner_capacity) / 2;
+    Btree_Node **siblings = _btree_children(parent);
+    Btree_Node *node = siblings[position];
+    Btree_Node *left = (position > 0) ? siblings[position - 1] : NULL;
+    Btree_Node *right = (position < parent->count) ? siblings[position + 1] : NULL;
+    if ((left != NULL) && (left->count > minimum)) {
+        // Moves the last element of the left sibling to the node
+        char *separator = _btree_key_at(tree, parent, position - 1);
+        if (is_leaf) {
+            CDATA_MEMMOVE(_btree_element_at(tree, node, 1), _btree_element_at(tree, node, 0), node->count*element_size);
+            CDATA_MEMCPY(_btree_element_at(tree, node, 0), _btree_element_at(tree, left, left->count - 1), element_size);
+            CDATA_MEMCPY(separator, _btree_element_at(tree, node, 0), element_size);
+        } else {
+            Btree_Node **children = _btree_children(node);
+            CDATA_MEMMOVE(_btree_key_at(tree, node, 1), _btree_key_at(tree, node, 0), node->count*element_size);
+            CDATA_MEMMOVE(&children[1], &children[0], (node->count + 1)*sizeof(Btree_Node *));
+            CDATA_MEMCPY(_btree_key_at(tree, node, 0), separator, element_size);
+            children[0] = _btree_children(left)[left->count];
+            CDATA_MEMCPY(separator, _btree_key_at(tree, left, left->count - 1), element_size);
+        }
+        left->count--;
+        node->count++;
+    } else if ((right != NULL) && (right->count > minimum)) {
+        // Moves the first element of the right sibling to the node
+        char *separator = _btree_key_at(tree, parent, position);
+        if (is_leaf) {
+            CDATA_MEMCPY(_btree_element_at(tree, node, node->count), _btree_element_at(tree, right, 0), element_size);
+            CDATA_MEMMOVE(_btree_element_at(tree, right, 0), _btree_element_at(tree, right, 1), (right->count - 1)*element_size);
+            CDATA_MEMCPY(separator, _btree_element_at(tree, right, 0), element_size);
+        } else {
+            Btree_Node **children = _btree_children(right);
+            CDATA_MEMCPY(_btree_key_at(tree, node, node->count), separator, element_size);
+            _btree_children(node)[node->count + 1] = children[0];
+            CDATA_MEMCPY(separator, _btree_key_at(tree, right, 0), element_size);
+            CDATA_MEMMOVE(_btree_key_at(tree, right, 0), _btree_key_at(tree, right, 1), (right->count - 1)*element_size);
+            CDATA_MEMMOVE(&children[0], &children[1], right->count*sizeof(Btree_Node *));
+        }
+        right->count--;
+        node->count++;
+    } else {
+        // Merges the node with one of its siblings, removing the right one
+        if (left != NULL) {
+            right = node;
+            position--;
+        } else {
+            left = node;
+        }
+        if (is_leaf) {
+            CDATA_MEMCPY(_btree_element_at(tree, left, left->count), _btree_element_at(tree, right, 0), right->count*element_size);
+            left->count += right->count;
+            left->next = right->next;
+        } else {
+            CDATA_MEMCPY(_btree_key_at(tree, left, left->count), _btree_key_at(tree, parent, position), element_size);
+            CDATA_MEMCPY(_btree_key_at(tree, left, left->count + 1), _btree_key_at(tree, right, 0), right->count*element_size);
+            CDATA_MEMCPY(&_btree_children(left)[left->count + 1], _btree_children(right), (right->count + 1)*sizeof(Btree_Node *));
+            left->count += right->count + 1;
+        }
+        CDATA_MEMMOVE(_btree_key_at(tree, parent, position), _btree_key_at(tree, parent, position + 1), (parent->count - position - 1)*element_size);
+        CDATA_MEMMOVE(&siblings[position + 1], &siblings[position + 2], (parent->count - position - 1)*sizeof(Btree_Node *));
+        parent->count--;
+        _btree_free_node(tree, right);
+    }
+}
+
+CDATA_FCN_DEF int btree_remove(Btree *tree, const void *key) {
+    Btree_Node *path[BTREE_MAX_HEIGHT];
+    size_t positions[BTREE_MAX_HEIGHT];
+    Btree_Node *node = tree->root;
+    if (node == NULL) {
+        return 0;
+    }
+    for (size_t level = 0; level + 1 < tree->height; level++) {
+        int found = 0;
+        const size_t position = _btree_search(tree, _btree_key_at(tree, node, 0), node->count, key, &found) + (size_t)found;
+        path[level] = node;
+        positions[level] = position;
+        node = _btree_children(node)[position];
+    }
+    int found = 0;
+    const size_t index = _btree_search(tree, _btree_element_at(tree, node, 0), node->count, key, &found);
+    if (!found) {
+        return 0;
+    }
+    char *address = _btree_element_at(tree, node, index);
+    CDATA_MEMMOVE(address, address + tree->element_size, (node->count - index - 1)*tree->element_size);
+    node->count--;
+    tree->size--;
+    // The separators may still hold the removed element, but they keep
+    // splitting the children correctly, so they aren't updated
+    for (size_t level = tree->height - 1; level > 0; level--) {
+        const int is_leaf = (level == tree->height - 1);
+        const size_t minimum = (is_leaf ? tree->leaf_capacity : tree->inner_capacity) / 2;
+        if (node->count >= minimum) {
+            break;
+        }
+        node = path[level - 1];
+        _btree_rebalance(tree, node, positions[level - 1], is_leaf);
+    }
+    Btree_Node *root = tree->root;
+    if ((tree->height == 1) && (root->count == 0)) {
+        _btree_free_node(tree, root);
+        tree->root = tree->first = NULL;
+        tree->height = 0;
+    } else if ((tree->height > 1) && (root->count == 0)) {
+        tree->root = _btree_children(root)[0];
+        tree->height--;
+        _btree_free_node(tree, root);
+    }
+    return 1;
+}
+
+CDATA_FCN_DEF Btree_Iterator btree_lower_bound(const Btree *tree, const void *key) {
+    Btree_Iterator it = { 0 };
+    Btree_Node *node = tree->root;
+    if (node == NULL) {
+        return it;
+    }
+    for (size_t level = 0; level + 1 < tree->height; level++) {
+        int found = 0;
+        const size_t position = _btree_search(tree, _btree_key_at(tree, node, 0), node->count, key, &found) + (size_t)found;
+        node = _btree_children(node)[position];
+    }
+    int found = 0;
+    it.node = node;
+    it.index = _btree_search(tree, _btree_element_at(tree, node, 0), node->count, key, &found);
+    if (it.index >= node->count) {
+        it.node = node->next;
+        it.index = 0;
+    }
+    return it;
+}
+
+CDATA_FCN_DEF Btree_Iterator btree_begin(const Btree *tree) {
+    Btree_Iterator it = { 0 };
+    it.node = tree->first;
+    return it;
+}
+
+CDATA_FCN_DEF void _btree_iterator_next(Btree_Iterator *it) {
+    it->index++;
+    if (it->index >= it->node->count) {
+        it->node = it->node->next;
+        it->index = 0;
+    }
+}
+
+CDATA_FCN_DEF void *btree_get(const Btree *tree, const void *key) {
+    Btree_Iterator it = btree_lower_bound(tree, key);
+    if (btree_iterator_is_valid(it) && (tree->compare(btree_iterator_get(tree, it), key) == 0)) {
+        return btree_iterator_get(tree, it);
+    }
+    return NULL;
+}
+
+// Builds the tree from the bottom up. The elements are spread evenly among
+// the nodes of each level, which are linked while the next level is built.
+CDATA_FCN_DEF int _btree_bulk_load(Btree *tree, const void *data, size_t count) {
+    CDATA_ASSERT(tree->root == NULL);
+    if (count == 0) {
+        return 0;
+    }
+    const char *elements = data;
+    size_t nodes = INT_DIV_ROUND_UP(count, tree->leaf_capacity);
+    Btree_Node *previous = NULL;
+    for (size_t i = 0, offset = 0; i < nodes; i++) {
+        Btree_Node *leaf = _btree_new_node(tree);
+        if (leaf == NULL) {
+            btree_delete(tree);
+            return -1;
+        }
+        leaf->count = count / nodes + (i < count % nodes);
+        CDATA_MEMCPY(_btree_element_at(tree, leaf, 0), elements + offset*tree->element_size, leaf->count*tree->element_size);
+        for (size_t j = 1; j < leaf->count; j++) {
+            CDATA_ASSERT(tree->compare(_btree_element_at(tree, leaf, j - 1), _btree_element_at(tree, leaf, j)) < 0);
+        }
+        offset += leaf->count;
+        if (previous != NULL) {
+            previous->next = leaf;
+        } else {
+            tree->first = leaf;
+        }
+        previous = leaf;
+    }
+    tree->size = count;
+    tree->height = 1;
+    Btree_Node *level_first = tree->first;
+    while (nodes > 1) {
+        const size_t children = nodes;
+        nodes = INT_DIV_ROUND_UP(children, tree->inner_capacity + 1);
+        Btree_Node *child = level_first;
+        previous = NULL;
+        for (size_t i = 0; i < nodes; i++) {
+            Btree_Node *node = _btree_new_node(tree);
+            if (node == NULL) {
+                btree_delete(tree);
+                return -1;
+            }
+            const size_t node_children = children / nodes + (i < children % nodes);
+            for (size_t j = 0; j < node_children; j++) {
+                _btree_children(node)[j] = child;
+                if (j > 0) {
+                    // The key is the smallest element below the child
+                    const Btree_Node *leaf = child;
+                    for (size_t level = 1; level < tree->height; level++) {
+                        leaf = _btree_children(leaf)[0];
+                    }
+                    CDATA_MEMCPY(_btree_key_at(tree, node, j - 1), _btree_element_at(tree, leaf, 0), tree->element_size);
+                }
+                child = child->next;
+            }
+            node->count = node_children - 1;
+            if (previous != NULL) {
+                previous->next = node;
+            } else {
+                level_first = node;
+            }
+            previous = node;
+        }
+        tree->height++;
+    }
+    tree->root = level_first;
+    return 0;
+}
+
+CDATA_FCN_DEF size_t _interner_entry_hash(const void *entry) {
+    return ((const Interner_Entry *)entry)->hash;
+}
+
+// The hashes are compared first, so the strings are only compared when they
+// are probably equal
+CDATA_FCN_DEF int _interner_entry_compare(const void *a, const void *b) {
+    const Interner_Entry *x = a;
+    const Interner_Entry *y = b;
+    if ((x->hash != y->hash) || (x->length != y->length)) {
+        return 1;
+    }
+    for (size_t i = 0; i < x->length; i++) {
+        if (x->string[i] != y->string[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+CDATA_FCN_DEF Symbol interner_lookup(const Interner *interner, const char *str, size_t length) {
+    if (interner->table == NULL) {
+        return SYMBOL_INVALID;
+    }
+    const Interner_Entry key = { .hash = djb2n(str, length), .string = str, .length = length };
+    const Interner_Entry *entry = hash_table_get(interner->table, &key);
+    return (entry != NULL) ? entry->symbol : SYMBOL_INVALID;
+}
+
+CDATA_FCN_DEF Symbol interner_intern(Interner *interner, const char *str, size_t length) {
+    if (interner->table == NULL) {
+        interner->table = hash_table_new(Interner_Entry, _interner_entry_hash, _interner_entry_compare);
+        if (interner->table == NULL) {
+            return SYMBOL_INVALID;
+        }
+    }
+    // The table is grown before it is probed, so that the position found for
+    // a new string is still valid when it is inserted. If it can't be grown,
+    // the old table is kept.
+    if (hash_table_should_resize(interner->table)) {
+        Interner_Entry *table = _hash_table_resize(interner->table, sizeof(Interner_Entry),
+            round_up_2(GROWTH_FACTOR*hash_table_capacity(interner->table)));
+        if (table == NULL) {
+            return SYMBOL_INVALID;
+        }
+        interner->table = table;
+    }
+    Interner_Entry entry = { .hash = djb2n(str, length), .string = str, .length = length };
+    const size_t index = _hash_table_get_index(interner->table, sizeof(Interner_Entry), &entry);
+    if (hash_table_is_occupied(interner->table, index)) {
+        return interner->table[index].symbol;
+    }
+    const size_t size = interner_size(interner);
+    CDATA_ASSERT(size < (size_t)SYMBOL_INVALID);
+    // The strings are copied to a new array, since the old one is freed by
+    // _array_resize when it fails
+    if ((interner->strings == NULL) || (size == array_capacity(interner->strings))) {
+        Interner_String *strings = _array_resize(NULL, sizeof(Interner_String), ARRAY_HEADER_SIZE,
+            INT_MAX(GROWTH_FACTOR*size, (size_t)ARRAY_DEFAULT_CAPACITY));
+        if (strings == NULL) {
+            return SYMBOL_INVALID;
+        }
+        if (size > 0) {
+            CDATA_MEMCPY(strings, interner->strings, size*sizeof(Interner_String));
+        }
+        array_size(strings) = size;
+        array_delete(interner->strings);
+        interner->strings = strings;
+    }
+    // The strings are stored one after the other, without padding
+    char *copy = arena_alloc_aligned(&interner->arena, length + 1, 1);
+    if (copy == NULL) {
+        return SYMBOL_INVALID;
+    }
+    CDATA_MEMCPY(copy, str, length);
+    copy[length] = '\0';
+    entry.string = copy;
+    entry.symbol = (Symbol)size;
+    interner->table[index] = entry;
+    hash_table_set_occupied(interner->table, index);
+    hash_table_size(interner->table)++;
+    interner->strings[size] = (Interner_String) { .string = copy, .length = length, .hash = entry.hash };
+    array_size(interner->strings)++;
+    return entry.symbol;
+}
+
+CDATA_FCN_DEF void interner_delete(Interner *interner) {
+    if (interner->table != NULL) {
+        hash_table_delete(interner->table);
+    }
+    array_delete(interner->strings);
+    arena_delete(&interner->arena);
+    interner->table = NULL;
+    interner->strings = NULL;
+}
+
+// Finalizer of MurmurHash3, which mixes all the bits of x
+CDATA_FCN_DEF uint64_t _perfect_hash_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+#define _perfect_hash_key_hash(hash_function,key,seed) \
+    _perfect_hash_mix((uint64_t)(hash_function)(key) ^ (seed))
+// As in PTHash, 60% of the keys go to 30% of the buckets, so that there are
+// more big buckets to be placed while most slots are free
+#define _perfect_hash_bucket(hash,buckets) \
+    ((((hash) & 0xFFFFFFFFU) < 0x99999999U) && ((buckets)*3/10 > 0) \
+        ? (size_t)(((hash) >> 32) % ((buckets)*3/10)) \
+        : (size_t)((buckets)*3/10 + ((hash) >> 32) % ((buckets) - (buckets)*3/10)))
+#define _perfect_hash_slot(hash,pilot,seed,size) \
+    ((size_t)(((hash) ^ _perfect_hash_mix((uint64_t)(pilot) ^ (seed))) % (size)))
+
+CDATA_FCN_DEF size_t _perfect_hash_data_size(const Perfect_Hash_Header *header) {
+    return sizeof(Perfect_Hash_Header) + INT_ROUND_UP((size_t)header->buckets*sizeof(uint32_t), sizeof(uint64_t))
+        + (size_t)(header->size*header->element_size);
+}
+
+// Places the buckets, from the biggest to the smallest one, trying the pilots
+// in order until all the keys of the bucket fall on free slots. Returns -1 if
+// some bucket can't be placed, and then another seed should be used.
+CDATA_FCN_DEF int _perfect_hash_search_pilots(uint32_t *pilots, size_t *slots, const uint64_t *hashes, const size_t *keys, const size_t *bucket_start, const size_t *bucket_order, size_t buckets, size_t size, uint64_t seed, uint64_t *taken) {
+    // The last buckets need about size tries, so this limit is rarely reached
+    const uint64_t max_pilot = INT_MIN((uint64_t)32*size + 1024, (uint64_t)UINT32_MAX);
+    for (size_t b = 0; b < buckets; b++) {
+        const size_t bucket = bucket_order[b];
+        const size_t start = bucket_start[bucket];
+        const size_t end = bucket_start[bucket + 1];
+        if (start == end) {
+            break;
+        }
+        uint64_t pilot = 0;
+        for (; pilot < max_pilot; pilot++) {
+            size_t i = start;
+            for (; i < end; i++) {
+                const size_t slot = _perfect_hash_slot(hashes[keys[i]], pilot, seed, size);
+                if (taken[slot / 64] & ((uint64_t)1 << (slot % 64))) {
+                    break;
+                }
+                taken[slot / 64] |= ((uint64_t)1 << (slot % 64));
+                slots[keys[i]] = slot;
+            }
+            if (i == end) {
+                break;
+            }
+            // Releases the slots taken by this pilot
+            while (i-- > start) {
+                const size_t slot = slots[keys[i]];
+                taken[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+            }
+        }
+        if (pilot == max_pilot) {
+            return -1;
+        }
+        pilots[bucket] = (uint32_t)pilot;
+    }
+    return 0;
+}
+
+CDATA_FCN_DEF int _perfect_hash_build(Perfect_Hash *perfect_hash, const void *elements, size_t element_size, size_t count, Hash_Fcn hash_function, Compare_Fcn compare_key) {
+    const size_t buckets = INT_MAX(INT_DIV_ROUND_UP(count, (size_t)PERFECT_HASH_BUCKET_SIZE), (size_t)1);
+    Perfect_Hash_Header header = {
+        .magic = PERFECT_HASH_MAGIC,
+        .element_size = element_size,
+        .size = count,
+        .buckets = buckets,
+        .seed = 0,
+    };
+    const size_t data_size = _perfect_hash_data_size(&header);
+    const size_t words = INT_DIV_ROUND_UP(count, (size_t)64);
+    // Memory used only during the construction
+    const size_t scratch_size = count*sizeof(uint64_t) + (3*count + 1)*sizeof(size_t) + (2*buckets + 1)*sizeof(size_t) + words*sizeof(uint64_t);
+    char *data = CDATA_REALLOC(NULL, data_size);
+    char *scratch = CDATA_REALLOC(NULL, INT_MAX(scratch_size, (size_t)1));
+    if ((data == NULL) || (scratch == NULL)) {
+        CDATA_FREE(data);
+        CDATA_FREE(scratch);
+        return -1;
+    }
+    uint64_t *hashes = (uint64_t *)scratch;
+    uint64_t *taken = hashes + count;
+    size_t *keys = (size_t *)(taken + words);       // Keys grouped by bucket
+    size_t *slots = keys + count;
+    size_t *bucket_start = slots + count;
+    size_t *bucket_order = bucket_start + buckets + 1;
+    size_t *counters = bucket_order + buckets;     // Used by the counting sorts
+    uint32_t *pilots = (uint32_t *)(data + sizeof(Perfect_Hash_Header));
+    const char *input = elements;
+    int status = -1;
+    for (uint64_t attempt = 0; (attempt < PERFECT_HASH_MAX_ATTEMPTS) && (status == -1); attempt++) {
+        header.seed = _perfect_hash_mix(attempt + 0x9E3779B97F4A7C15ULL);
+        // Groups the keys by bucket, with a counting sort
+        CDATA_MEMSET(bucket_start, 0, (buckets + 1)*sizeof(size_t));
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = _perfect_hash_key_hash(hash_function, input + i*element_size, header.seed);
+            bucket_start[_perfect_hash_bucket(hashes[i], buckets) + 1]++;
+        }
+        size_t max_bucket_size = 0;
+        for (size_t b = 0; b < buckets; b++) {
+            max_bucket_size = INT_MAX(max_bucket_size, bucket_start[b + 1]);
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        CDATA_MEMSET(counters, 0, buckets*sizeof(size_t));
+        for (size_t i = 0; i < count; i++) {
+            const size_t bucket = _perfect_hash_bucket(hashes[i], buckets);
+            keys[bucket_start[bucket] + counters[bucket]++] = i;
+        }
+        // Keys with the same hash can't be separated by any pilot. The seed is
+        // mixed after the hash function, so they would have the same hash with
+        // any other seed as well.
+        status = 0;
+        for (size_t b = 0; (b < buckets) && (status == 0); b++) {
+            for (size_t i = bucket_start[b]; (i < bucket_start[b + 1]) && (status == 0); i++) {
+                for (size_t j = i + 1; j < bucket_start[b + 1]; j++) {
+                    if (hashes[keys[i]] == hashes[keys[j]]) {
+                        const int equal = (compare_key(input + keys[i]*element_size, input + keys[j]*element_size) == 0);
+                        status = equal ? -2 : -3;
+                        break;
+                    }
+                }
+            }
+        }
+        if (status != 0) {
+            break;
+        }
+        // Sorts the buckets by decreasing size, with another counting sort
+        CDATA_MEMSET(counters, 0, (max_bucket_size + 1)*sizeof(size_t));
+        for (size_t b = 0; b < buckets; b++) {
+            counters[max_bucket_size - (bucket_start[b + 1] - bucket_start[b])]++;
+        }
+        for (size_t i = 0, sum = 0; i <= max_bucket_size; i++) {
+            const size_t number = counters[i];
+            counters[i] = sum;
+            sum += number;
+        }
+        for (size_t b = 0; b < buckets; b++) {
+            bucket_order[counters[max_bucket_size - (bucket_start[b + 1] - bucket_start[b])]++] = b;
+        }
+        CDATA_MEMSET(taken, 0, words*sizeof(uint64_t));
+        CDATA_MEMSET(pilots, 0, buckets*sizeof(uint32_t));
+        status = _perfect_hash_search_pilots(pilots, slots, hashes, keys, bucket_start, bucket_order, buckets, count, header.seed, taken);
+    }
+    if (status != 0) {
+        CDATA_FREE(data);
+        CDATA_FREE(scratch);
+        // Running out of attempts is very unlikely, unless the hash function
+        // gives only a few different values
+        return (status == -1) ? -3 : status;
+    }
+    CDATA_MEMCPY(data, &header, sizeof(header));
+    char *output = data + sizeof(Perfect_Hash_Header) + INT_ROUND_UP(buckets*sizeof(uint32_t), sizeof(uint64_t));
+    for (size_t i = 0; i < count; i++) {
+        CDATA_MEMCPY(output + slots[i]*element_size, input + i*element_size, element_size);
+    }
+    CDATA_FREE(scratch);
+    const int loaded = _perfect_hash_load(perfect_hash, element_size, data, data_size, hash_function, compare_key);
+    CDATA_ASSERT(loaded == 0);
+    (void)loaded;
+    perfect_hash->owned_data = data;
+    return 0;
+}
+
+CDATA_FCN_DEF int _perfect_hash_from_hash_table(Perfect_Hash *perfect_hash, void *hash_table, size_t element_size) {
+    void *array = _hash_table_to_array(hash_table, element_size);
+    if (array == NULL) {
+        return -1;
+    }
+    const int status = _perfect_hash_build(perfect_hash, array, element_size, array_size(array),
+        hash_table_hash_function(hash_table), hash_table_compare_function(hash_table));
+    array_delete(array);
+    return status;
+}
+
+CDATA_FCN_DEF int _perfect_hash_load(Perfect_Hash *perfect_hash, size_t element_size, const void *data, size_t data_size, Hash_Fcn hash_function, Compare_Fcn compare_key) {
+    const Perfect_Hash_Header *header = data;
+    if ((data_size < sizeof(Perfect_Hash_Header)) || (header->magic != PERFECT_HASH_MAGIC) ||
+        (element_size == 0) || (header->element_size != element_size)) {
+        return -1;
+    }
+    // The sizes are checked against the size of the data before they are
+    // multiplied, so that the size computed from them can't overflow
+    const uint64_t available = (uint64_t)(data_size - sizeof(Perfect_Hash_Header));
+    if ((header->size > available/element_size) || (header->buckets == 0) ||
+        (header->buckets > header->size + 1) || (header->buckets > available/sizeof(uint32_t)) ||
+        (_perfect_hash_data_size(header) != data_size)) {
+        return -1;
+    }
+    perfect_hash->hash_function = hash_function;
+    perfect_hash->compare_key = compare_key;
+    perfect_hash->header = header;
+    perfect_hash->pilots = (const uint32_t *)((const char *)data + sizeof(Perfect_Hash_Header));
+    perfect_hash->elements = (const char *)data + sizeof(Perfect_Hash_Header) + INT_ROUND_UP((size_t)header->buckets*sizeof(uint32_t), sizeof(uint64_t));
+    perfect_hash->owned_data = NULL;
+    return 0;
+}
+
+CDATA_FCN_DEF void perfect_hash_delete(Perfect_Hash *perfect_hash) {
+    CDATA_FREE(perfect_hash->owned_data);
+    CDATA_MEMSET(perfect_hash, 0, sizeof(*perfect_hash));
+}
+
+CDATA_FCN_DEF size_t perfect_hash_index(const Perfect_Hash *perfect_hash, const void *key) {
+    const Perfect_Hash_Header *header = perfect_hash->header;
+    if (header->size == 0) {
+        return 0;
+    }
+    const uint64_t hash = _perfect_hash_key_hash(perfect_hash->hash_function, key, header->seed);
+    const uint32_t pilot = perfect_hash->pilots[_perfect_hash_bucket(hash, header->buckets)];
+    return _perfect_hash_slot(hash, pilot, header->seed, header->size);
+}
+
+CDATA_FCN_DEF void *perfect_hash_get(const Perfect_Hash *perfect_hash, const void *key) {
+    if (perfect_hash->header->size == 0) {
+        return NULL;
+    }
+    void *element = perfect_hash_element_at(perfect_hash, perfect_hash_index(perfect_hash, key));
+    return (perfect_hash->compare_key(element, key) == 0) ? element : NULL;
+}
+
+CDATA_FCN_DEF size_t _bitset_popcount64(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t)__builtin_popcountll(word);
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (size_t)((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// The word should not be zero
+CDATA_FCN_DEF size_t _bitset_ctz64(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t)__builtin_ctzll(word);
+#else
+    size_t count = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+// When the popcnt instruction is available, counting word by word is faster.
+// Otherwise, the bits of two words are counted at once with SSE2, and the
+// counts of the bytes are summed by _mm_sad_epu8.
+CDATA_FCN_DEF size_t _bitset_popcount_words(const uint64_t *words, size_t count) {
+    size_t total = 0;
+    size_t i = 0;
+#if defined(CDATA_SSE2_SUPPORTED) && !defined(__POPCNT__)
+    const __m128i m1 = _mm_set1_epi8(0x55);
+    const __m128i m2 = _mm_set1_epi8(0x33);
+    const __m128i m4 = _mm_set1_epi8(0x0F);
+    __m128i sums = _mm_setzero_si128();
+    for (; i + 2 <= count; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(words + i));
+        v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi64(v, 1), m1));
+        v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi64(v, 2), m2));
+        v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi64(v, 4)), m4);
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(v, _mm_setzero_si128()));
+    }
+    uint64_t partial[2];
+    _mm_storeu_si128((__m128i *)partial, sums);
+    total = (size_t)(partial[0] + partial[1]);
+#endif
+    for (; i < count; i++) {
+        total += _bitset_popcount64(words[i]);
+    }
+    return total;
+}
+
+CDATA_FCN_DEF uint64_t *_bitset_resize(uint64_t *bitset, size_t bits) {
+    const size_t words = INT_DIV_ROUND_UP(bits, BITSET_WORD_BITS);
+    if ((bitset == NULL) || (words > array_capacity(bitset))) {
+        bitset = _array_resize(bitset, sizeof(uint64_t), BITSET_HEADER_SIZE, round_up_2(INT_MAX(words, 1)));
+        if (bitset == NULL) {
+            return NULL;
+        }
+    } else if (bits < bitset_size(bitset)) {
+        // Keeps the bits after the end cleared
+        CDATA_MEMSET(bitset + words, 0, (array_size(bitset) - words)*sizeof(uint64_t));
+        if ((bits % BITSET_WORD_BITS) != 0) {
+            bitset[words - 1] &= ((uint64_t)1 << (bits % BITSET_WORD_BITS)) - 1;
+        }
+    }
+    bitset_size(bitset) = bits;
+    array_size(bitset) = words;
+    return bitset;
+}
+
+#ifdef CDATA_SSE2_SUPPORTED
+#define _bitset_mm_andnot(a,b)                  _mm_andnot_si128((b), (a))
+#define _bitset_apply(dst,src,words,vector_operation,scalar_operator) \
+    do { \
+        size_t _bitset_index = 0; \
+        for (; _bitset_index + 2 <= (words); _bitset_index += 2) { \
+            const __m128i a = _mm_loadu_si128((const __m128i *)((dst) + _bitset_index)); \
+            const __m128i b = _mm_loadu_si128((const __m128i *)((src) + _bitset_index)); \
+            _mm_storeu_si128((__m128i *)((dst) + _bitset_index), vector_operation(a, b)); \
+        } \
+        for (; _bitset_index < (words); _bitset_index++) { \
+            (dst)[_bitset_index] = (dst)[_bitset_index] scalar_operator (src)[_bitset_index]; \
+        } \
+    } while (0)
+#else
+#define _bitset_apply(dst,src,words,vector_operation,scalar_operator) \
+    do { \
+        for (size_t _bitset_index = 0; _bitset_index < (words); _bitset_index++) { \
+            (dst)[_bitset_index] = (dst)[_bitset_index] scalar_operator (src)[_bitset_index]; \
+        } \
+    } while (0)
+#endif
+
+CDATA_FCN_DEF uint64_t *_bitset_operation(uint64_t *dst, const uint64_t *src, Bitset_Operation operation) {
+    const size_t src_bits = (src != NULL) ? bitset_size(src) : 0;
+    if (((operation == BITSET_OR) || (operation == BITSET_XOR)) && ((dst == NULL) || (bitset_size(dst) < src_bits))) {
+        dst = _bitset_resize(dst, src_bits);
+    }
+    if (dst == NULL) {
+        return NULL;
+    }
+    const size_t words = (src != NULL) ? INT_MIN(array_size(dst), array_size(src)) : 0;
+    switch (operation) {
+    case BITSET_AND:
+        _bitset_apply(dst, src, words, _mm_and_si128, &);
+        // The bits after the end of src are zero
+        CDATA_MEMSET(dst + words, 0, (array_size(dst) - words)*sizeof(uint64_t));
+        break;
+    case BITSET_OR:
+        _bitset_apply(dst, src, words, _mm_or_si128, |);
+        break;
+    case BITSET_XOR:
+        _bitset_apply(dst, src, words, _mm_xor_si128, ^);
+        break;
+    case BITSET_ANDNOT:
+        _bitset_apply(dst, src, words, _bitset_mm_andnot, & ~);
+        break;
+    }
+    return dst;
+}
+
+CDATA_FCN_DEF size_t bitset_popcount(const uint64_t *bitset) {
+    if (bitset == NULL) {
+        return 0;
+    }
+    return _bitset_popcount_words(bitset, array_size(bitset));
+}
+
+CDATA_FCN_DEF size_t bitset_find_next(const uint64_t *bitset, size_t index) {
+    if ((bitset == NULL) || (index >= bitset_size(bitset))) {
+        return (bitset == NULL) ? 0 : bitset_size(bitset);
+    }
+    const size_t words = array_size(bitset);
+    size_t i = index/BITSET_WORD_BITS;
+    // Ignores the bits before index in its word
+    uint64_t word = bitset[i] & (~(uint64_t)0 << (index % BITSET_WORD_BITS));
+    while (word == 0) {
+        i++;
+#ifdef CDATA_SSE2_SUPPORTED
+        // Skips two empty words at a time
+        while ((i + 2 <= words) &&
+            (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(bitset + i)), _mm_setzero_si128())) == 0xFFFF)) {
+            i += 2;
+        }
+#endif
+        if (i >= words) {
+            return bitset_size(bitset);
+        }
+        word = bitset[i];
+    }
+    return i*BITSET_WORD_BITS + _bitset_ctz64(word);
+}
+
+CDATA_FCN_DEF size_t bitset_rank(const uint64_t *bitset, size_t index) {
+    if (bitset == NULL) {
+        return 0;
+    }
+    index = INT_MIN(index, bitset_size(bitset));
+    size_t rank = _bitset_popcount_words(bitset, index/BITSET_WORD_BITS);
+    if ((index % BITSET_WORD_BITS) != 0) {
+        rank += _bitset_popcount64(bitset[index/BITSET_WORD_BITS] & (((uint64_t)1 << (index % BITSET_WORD_BITS)) - 1));
+    }
+    return rank;
+}
+
+// The index holds the number of set bits before each block, and the total
+CDATA_FCN_DEF size_t *_bitset_rank_build(size_t *rank_index, const uint64_t *bitset) {
+    const size_t words = (bitset != NULL) ? array_size(bitset) : 0;
+    const size_t blocks = INT_DIV_ROUND_UP(words, BITSET_RANK_BLOCK_WORDS);
+    array_clear(rank_index);
+    rank_index = _array_resize_if_needed(rank_index, sizeof(size_t), blocks + 1);
+    if (rank_index == NULL) {
+        return NULL;
     }
-    size_t index = _array_binary_search(*array, element_size, element, compare);
-    if (array_index_is_valid(*array, index)) {
-        if (user_index != NULL) {
-            *user_index = index;
-        }
-        return(0);
+    size_t rank = 0;
+    for (size_t block = 0; block < blocks; block++) {
+        rank_index[block] = rank;
+        const size_t start = block*BITSET_RANK_BLOCK_WORDS;
+        rank += _bitset_popcount_words(bitset + start, INT_MIN(BITSET_RANK_BLOCK_WORDS, words - start));
     }
-    // Insert new element
-    index = (size_t)(-1L*(long)index - 1);
-    *array = _array_insert_zero_at(*array, element_size, index);
-    if (*array == NULL) {
-        return(-1);
+    rank_index[blocks] = rank;
+    array_size(rank_index) = blocks + 1;
+    return rank_index;
+}
+
+CDATA_FCN_DEF size_t bitset_rank_indexed(const uint64_t *bitset, const size_t *rank_index, size_t index) {
+    if (bitset == NULL) {
+        return 0;
     }
-    void *it = array_compute_address_at(*array, element_size, index);
-    CDATA_MEMCPY(it, element, element_size);
-    if (user_index != NULL) {
-        *user_index = index;
+    index = INT_MIN(index, bitset_size(bitset));
+    const size_t word = index/BITSET_WORD_BITS;
+    const size_t block = word/BITSET_RANK_BLOCK_WORDS;
+    size_t rank = rank_index[block] + _bitset_popcount_words(bitset + block*BITSET_RANK_BLOCK_WORDS, word % BITSET_RANK_BLOCK_WORDS);
+    if ((index % BITSET_WORD_BITS) != 0) {
+        rank += _bitset_popcount64(bitset[word] & (((uint64_t)1 << (index % BITSET_WORD_BITS)) - 1));
     }
-    return(1);
+    return rank;
 }
 
-CDATA_FCN_DEF size_t djb2(const char *str) {
-    size_t hash = 5381;
-    for (; *str; ++str) {
-        /* hash * 33 + c */
-        hash = ((hash << 5) + hash) + (size_t)*str;
+CDATA_FCN_DEF Slot_Map _slot_map_new(size_t element_size) {
+    Slot_Map map = { 0 };
+    map.element_size = element_size;
+    map.free_slots = SLOT_MAP_FREE_LIST_END;
+    return map;
+}
+
+CDATA_FCN_DEF void slot_map_delete(Slot_Map *map) {
+    array_delete(map->elements);
+    array_delete(map->element_slots);
+    array_delete(map->slots);
+    map->elements = NULL;
+    map->element_slots = NULL;
+    map->slots = NULL;
+    map->free_slots = SLOT_MAP_FREE_LIST_END;
+}
+
+CDATA_FCN_DEF Slot_Map_Handle _slot_map_handle(uint32_t slot, uint32_t generation) {
+    return ((Slot_Map_Handle)generation << 32) | (Slot_Map_Handle)slot;
+}
+
+// Makes the generation of the slot even, and puts it in the list of free
+// slots. A slot whose generation wraps around isn't used again, so that
+// the old handles never become valid.
+CDATA_FCN_DEF void _slot_map_free_slot(Slot_Map *map, uint32_t slot) {
+    map->slots[slot].generation++;
+    if (map->slots[slot].generation != 0) {
+        map->slots[slot].index = map->free_slots;
+        map->free_slots = slot;
     }
-    return hash;
 }
 
-CDATA_FCN_DEF void *_hash_table_new(size_t element_size, Hash_Fcn hash_function, Compare_Fcn compare_key, size_t initial_capacity) {
-    size_t header_size = hash_table_header_size_from_capacity(initial_capacity);
-    void *hash_table = _array_resize(NULL, element_size, header_size, initial_capacity);
-    if (hash_table != NULL) {
-        hash_table_hash_function(hash_table) = hash_function;
-        hash_table_compare_function(hash_table) = compare_key;
+CDATA_FCN_DEF void slot_map_clear(Slot_Map *map) {
+    for (size_t i = 0; i < slot_map_size(map); i++) {
+        _slot_map_free_slot(map, map->element_slots[i]);
     }
-    return hash_table;
+    array_clear(map->elements);
+    array_clear(map->element_slots);
 }
 
-// This function returns the index of the key if it is present in the hash table.
-// If it is not present, the function returns the next non-occupied index (if there is one).
-CDATA_FCN_DEF size_t _hash_table_get_index(void *hash_table, size_t element_size, const void *key) {
-    size_t index = hash_table_compute_hash(hash_table, key);
-    size_t i = 0;
-    for (; i < hash_table_capacity(hash_table); i++) {
-        if (!hash_table_is_occupied(hash_table, index)) {
-            break;
-        }
-        void *it = hash_table_compute_address_at(hash_table,element_size,index);
-        if (hash_table_compare_keys(hash_table, it, key) == 0) {
-            break;
+CDATA_FCN_DEF Slot_Map_Handle slot_map_insert(Slot_Map *map, const void *value) {
+    uint32_t slot = map->free_slots;
+    if (slot == SLOT_MAP_FREE_LIST_END) {
+        const size_t slots = array_is_empty(map->slots) ? 0 : array_size(map->slots);
+        if (slots >= SLOT_MAP_FREE_LIST_END) {
+            return SLOT_MAP_HANDLE_INVALID;
         }
-#ifdef QUADRATIC_PROBING
-        index = (index + i*i) % hash_table_capacity(hash_table);
-#else // LINEAR_PROBING
-        index = (index + 1) % hash_table_capacity(hash_table);
-#endif
+        const Slot_Map_Slot empty = { 0 };
+        array_push(map->slots, empty);
+        slot = (uint32_t)slots;
+    } else {
+        map->free_slots = map->slots[slot].index;
     }
-    if (i >= hash_table_capacity(hash_table)) {
-        // The table is full and the key wasn't found
-        return((size_t)-1);
+    const size_t index = slot_map_size(map);
+    map->elements = _array_resize_if_needed(map->elements, map->element_size, 1);
+    CDATA_ASSERT(map->elements != NULL);
+    void *element = slot_map_element_at(map, index);
+    if (value != NULL) {
+        CDATA_MEMCPY(element, value, map->element_size);
+    } else {
+        CDATA_MEMSET(element, 0, map->element_size);
     }
-    return(index);
+    array_size(map->elements)++;
+    array_push(map->element_slots, slot);
+    map->slots[slot].index = (uint32_t)index;
+    map->slots[slot].generation++;
+    return _slot_map_handle(slot, map->slots[slot].generation);
 }
 
-CDATA_FCN_DEF void *_hash_table_get(void *hash_table, size_t element_size, const void *key) {
-    size_t index = _hash_table_get_index(hash_table, element_size, key);
-    if (index >= hash_table_capacity(hash_table)) {
-        return(NULL);
+#define _slot_map_handle_is_valid(map,handle) \
+    ((slot_map_handle_slot(handle) < (array_is_empty((map)->slots) ? 0 : array_size((map)->slots))) && \
+    ((slot_map_handle_generation(handle) & 1) != 0) && \
+    ((map)->slots[slot_map_handle_slot(handle)].generation == slot_map_handle_generation(handle)))
+
+CDATA_FCN_DEF void *slot_map_get(const Slot_Map *map, Slot_Map_Handle handle) {
+    if (!_slot_map_handle_is_valid(map, handle)) {
+        return NULL;
     }
-    if (hash_table_is_occupied(hash_table, index)) {
-        void *it = hash_table_compute_address_at(hash_table,element_size,index);
-        return(it);
+    return slot_map_element_at(map, map->slots[slot_map_handle_slot(handle)].index);
+}
+
+CDATA_FCN_DEF int slot_map_remove(Slot_Map *map, Slot_Map_Handle handle) {
+    if (!_slot_map_handle_is_valid(map, handle)) {
+        return 0;
     }
-    return(NULL);
+    const uint32_t slot = slot_map_handle_slot(handle);
+    const size_t index = map->slots[slot].index;
+    const size_t last = slot_map_size(map) - 1;
+    // The last element takes the place of the removed one
+    if (index != last) {
+        CDATA_MEMCPY(slot_map_element_at(map, index), slot_map_element_at(map, last), map->element_size);
+        const uint32_t moved = map->element_slots[last];
+        map->element_slots[index] = moved;
+        map->slots[moved].index = (uint32_t)index;
+    }
+    array_size(map->elements)--;
+    array_size(map->element_slots)--;
+    _slot_map_free_slot(map, slot);
+    return 1;
 }
 
-CDATA_FCN_DEF void *_hash_table_resize(void *hash_table, size_t element_size, size_t new_capacity) {
-    void *new_hash_table = _hash_table_new(element_size,
-        hash_table_hash_function(hash_table),
-        hash_table_compare_function(hash_table),
-        new_capacity);
-    if (new_hash_table == NULL) {
-        return(NULL);
+#define _cache_slot(cache,position) \
+    ((Cache_Slot *)((cache)->slots + (position)*(cache)->slot_size))
+#define _cache_element(cache,slot)              ((void *)((char *)(slot) + (cache)->element_offset))
+// Mixes the bits of the hash, since the table uses only the lowest ones
+#define _cache_hash(cache,key) \
+    ((cache)->hash_function(key) * (size_t)0x9E3779B97F4A7C15ULL >> 16)
+
+CDATA_FCN_DEF Cache *_cache_new(size_t element_size, size_t capacity, Cache_Policy policy, Hash_Fcn hash_function, Compare_Fcn compare_key) {
+    capacity = INT_MAX(capacity, (size_t)1);
+    // The table respects the load factor of the hash tables when it is full
+    const size_t slots = round_up_2(INT_DIV_ROUND_UP(capacity*LOAD_FACTOR_DENOMINATOR, LOAD_FACTOR_NUMERATOR) + 1);
+    CDATA_ASSERT(slots < CACHE_NO_SLOT);
+    // The elements are aligned as required by types of their size
+    const size_t alignment = INT_MAX(CDATA_ALIGNMENT_OF_SIZE(element_size), ARENA_DEFAULT_ALIGNMENT);
+    const size_t element_offset = INT_ROUND_UP(sizeof(Cache_Slot), alignment);
+    const size_t slot_size = INT_ROUND_UP(element_offset + element_size, alignment);
+    const size_t header_size = INT_ROUND_UP(sizeof(Cache), alignment);
+    Cache *cache = CDATA_REALLOC(NULL, header_size + slots*slot_size);
+    if (cache == NULL) {
+        return NULL;
     }
-    for (size_t i = 0; i < hash_table_capacity(hash_table); i++) {
-        if (hash_table_is_occupied(hash_table, i)) {
-            // Insert every element from the old hash table into the new one
-            // OBS: the indexes may change
-            void *it = hash_table_compute_address_at(hash_table, element_size, i);
-            size_t index = _hash_table_get_index(new_hash_table, element_size, it);
-            void *address = hash_table_compute_address_at(new_hash_table, element_size, index);
-            CDATA_MEMCPY(address, it, element_size);
-            hash_table_set_occupied(new_hash_table, index);
+    *cache = (Cache) {
+        .element_size = element_size,
+        .element_offset = element_offset,
+        .slot_size = slot_size,
+        .capacity = capacity,
+        .mask = slots - 1,
+        .policy = policy,
+        .hash_function = hash_function,
+        .compare_key = compare_key,
+        .slots = (char *)cache + header_size,
+    };
+    cache_clear(cache);
+    return cache;
+}
+
+CDATA_FCN_DEF void cache_clear(Cache *cache) {
+    for (size_t position = 0; position <= cache->mask; position++) {
+        _cache_slot(cache, position)->occupied = 0;
+    }
+    cache->size = 0;
+    cache->most_recent = CACHE_NO_SLOT;
+    cache->least_recent = CACHE_NO_SLOT;
+    cache->hand = 0;
+}
+
+// Returns the position of the key in the table, or the empty position where it should be inserted
+CDATA_FCN_DEF size_t _cache_find(const Cache *cache, const void *key, size_t hash) {
+    size_t position = hash & cache->mask;
+    for (;;) {
+        const Cache_Slot *slot = _cache_slot(cache, position);
+        if (!slot->occupied ||
+            ((slot->hash == hash) && (cache->compare_key(_cache_element(cache, slot), key) == 0))) {
+            return position;
         }
-        hash_table_size(new_hash_table) = hash_table_size(hash_table);
+        position = (position + 1) & cache->mask;
     }
-    hash_table_delete(hash_table);
-    return(new_hash_table);
 }
 
-CDATA_FCN_DEF void *_hash_table_resize_if_needed(void *hash_table, size_t element_size) {
-    if (LOAD_FACTOR_DENOMINATOR*hash_table_size(hash_table) >= LOAD_FACTOR_NUMERATOR*hash_table_capacity(hash_table)) {
-        size_t new_capacity = GROWTH_FACTOR*hash_table_capacity(hash_table);
-        new_capacity = round_up_2(new_capacity);
-        hash_table = _hash_table_resize(hash_table, element_size, new_capacity);
+// Inserts the element in the beginning of the list ordered by use
+CDATA_FCN_DEF void _cache_link(Cache *cache, size_t position) {
+    Cache_Slot *slot = _cache_slot(cache, position);
+    slot->previous = CACHE_NO_SLOT;
+    slot->next = cache->most_recent;
+    if (cache->most_recent != CACHE_NO_SLOT) {
+        _cache_slot(cache, cache->most_recent)->previous = (uint32_t)position;
+    } else {
+        cache->least_recent = (uint32_t)position;
     }
-    return(hash_table);
+    cache->most_recent = (uint32_t)position;
 }
 
-CDATA_FCN_DEF int _hash_table_insert(void **hash_table, size_t element_size, const void *value, void **const user_address) {
-    *hash_table = _hash_table_resize_if_needed(*hash_table, element_size);
-    size_t index = _hash_table_get_index(*hash_table, element_size, value);
-    void *address = hash_table_compute_address_at(*hash_table, element_size, index);
-    if (hash_table_is_occupied(*hash_table, index)) {
-        // The element is already present in the hash table
-        if (user_address != NULL) {
-            *user_address = address;
-        }
-        return(0);
+CDATA_FCN_DEF void _cache_unlink(Cache *cache, size_t position) {
+    const Cache_Slot *slot = _cache_slot(cache, position);
+    if (slot->previous != CACHE_NO_SLOT) {
+        _cache_slot(cache, slot->previous)->next = slot->next;
+    } else {
+        cache->most_recent = slot->next;
     }
-    CDATA_MEMCPY(address, value, element_size);
-    hash_table_set_occupied(*hash_table, index);
-    hash_table_size(*hash_table)++;
-    if (user_address != NULL) {
-        *user_address = address;
+    if (slot->next != CACHE_NO_SLOT) {
+        _cache_slot(cache, slot->next)->previous = slot->previous;
+    } else {
+        cache->least_recent = slot->previous;
     }
-    return(1);
 }
 
-CDATA_FCN_DEF void *_hash_table_to_array(const void *hash_table, size_t element_size) {
-    void *array = _array_resize(NULL, element_size, ARRAY_HEADER_SIZE, hash_table_capacity(hash_table));
-    if (array == NULL) {
-        return(NULL);
+// Marks the element as used
+CDATA_FCN_DEF void _cache_touch(Cache *cache, size_t position) {
+    switch (cache->policy) {
+    case CACHE_LRU:
+        if (cache->most_recent != position) {
+            _cache_unlink(cache, position);
+            _cache_link(cache, position);
+        }
+        break;
+    case CACHE_CLOCK:
+        _cache_slot(cache, position)->referenced = 1;
+        break;
     }
-    for (size_t i = 0; i < hash_table_capacity(hash_table); i++) {
-        if (hash_table_is_occupied(hash_table, i)) {
-            void *it = hash_table_compute_address_at(hash_table, element_size, i);
-            array_push_raw(array,it,element_size);
+}
+
+// Returns the position of the element to be evicted. The cache shouldn't be empty.
+CDATA_FCN_DEF size_t _cache_victim(Cache *cache) {
+    switch (cache->policy) {
+    case CACHE_LRU:
+        break;
+    case CACHE_CLOCK:
+        for (;;) {
+            Cache_Slot *slot = _cache_slot(cache, cache->hand);
+            if (slot->occupied) {
+                if (!slot->referenced) {
+                    return cache->hand;
+                }
+                slot->referenced = 0;
+            }
+            cache->hand = (cache->hand + 1) & cache->mask;
         }
     }
-    return(array);
+    return cache->least_recent;
 }
 
-CDATA_FCN_DEF void *arena_alloc(Arena *arena, size_t size) {
-    size = INT_ROUND_UP(size, sizeof(void *));
-    for (Region *current = arena->current; current != NULL; current = current->next) {
-        arena->current = current;
-        size_t available = current->capacity - current->occupied;
-        if (available > size) {
-            void *data = (void *)((size_t)current->data + current->occupied);
-            current->occupied += size;
-            return data;
+// Removes the element, shifting back the following elements of the probe
+// sequence, and updating the links to the elements that were moved
+CDATA_FCN_DEF void _cache_remove_at(Cache *cache, size_t position) {
+    if (cache->policy == CACHE_LRU) {
+        _cache_unlink(cache, position);
+    }
+    size_t next = position;
+    for (;;) {
+        next = (next + 1) & cache->mask;
+        const Cache_Slot *slot = _cache_slot(cache, next);
+        if (!slot->occupied) {
+            break;
+        }
+        const size_t home = slot->hash & cache->mask;
+        // Distance from the home of the element, to the free position and to its current position
+        if (((position - home) & cache->mask) < ((next - home) & cache->mask)) {
+            CDATA_MEMCPY(_cache_slot(cache, position), slot, cache->slot_size);
+            if (cache->policy == CACHE_LRU) {
+                if (slot->previous != CACHE_NO_SLOT) {
+                    _cache_slot(cache, slot->previous)->next = (uint32_t)position;
+                } else {
+                    cache->most_recent = (uint32_t)position;
+                }
+                if (slot->next != CACHE_NO_SLOT) {
+                    _cache_slot(cache, slot->next)->previous = (uint32_t)position;
+                } else {
+                    cache->least_recent = (uint32_t)position;
+                }
+            }
+            position = next;
         }
     }
-    size_t capacity = INT_MAX(size, ARENA_DEFAULT_REGION_CAPACITY);
-    Region *new_region = CDATA_REALLOC(NULL, capacity + sizeof(Region));
-    if (new_region == NULL) {
+    _cache_slot(cache, position)->occupied = 0;
+    cache->size--;
+}
+
+CDATA_FCN_DEF void *cache_get(Cache *cache, const void *key) {
+    const size_t position = _cache_find(cache, key, _cache_hash(cache, key));
+    Cache_Slot *slot = _cache_slot(cache, position);
+    if (!slot->occupied) {
+        cache->misses++;
         return NULL;
     }
-    new_region->next = NULL;
-    new_region->capacity = capacity;
-    new_region->occupied = size;
-    if (arena->current != NULL) {
-        arena->current->next = new_region;
+    cache->hits++;
+    _cache_touch(cache, position);
+    return _cache_element(cache, slot);
+}
+
+CDATA_FCN_DEF void *cache_peek(const Cache *cache, const void *key) {
+    Cache_Slot *slot = _cache_slot(cache, _cache_find(cache, key, _cache_hash(cache, key)));
+    return slot->occupied ? _cache_element(cache, slot) : NULL;
+}
+
+CDATA_FCN_DEF int cache_put(Cache *cache, const void *element, void *evicted) {
+    const size_t hash = _cache_hash(cache, element);
+    size_t position = _cache_find(cache, element, hash);
+    Cache_Slot *slot = _cache_slot(cache, position);
+    if (slot->occupied) {
+        CDATA_MEMCPY(_cache_element(cache, slot), element, cache->element_size);
+        _cache_touch(cache, position);
+        return 0;
     }
-    arena->current = new_region;
-    if (arena->first == NULL) {
-        arena->first = new_region;
+    int eviction = 0;
+    if (cache->size == cache->capacity) {
+        const size_t victim = _cache_victim(cache);
+        if (evicted != NULL) {
+            CDATA_MEMCPY(evicted, _cache_element(cache, _cache_slot(cache, victim)), cache->element_size);
+        }
+        _cache_remove_at(cache, victim);
+        cache->evictions++;
+        eviction = 1;
+        // The elements after the evicted one may have been shifted back
+        position = _cache_find(cache, element, hash);
+        slot = _cache_slot(cache, position);
+    }
+    slot->hash = hash;
+    slot->occupied = 1;
+    slot->referenced = 0;
+    CDATA_MEMCPY(_cache_element(cache, slot), element, cache->element_size);
+    if (cache->policy == CACHE_LRU) {
+        _cache_link(cache, position);
     }
-    return new_region->data;
+    cache->size++;
+    return eviction;
 }
 
-CDATA_FCN_DEF char *arena_strdup(Arena *arena, const char *str) {
-    size_t len = CDATA_STRLEN(str) + 1;
-    char *dup = arena_alloc(arena, len);
-    if (dup == NULL) {
+CDATA_FCN_DEF int cache_remove(Cache *cache, const void *key, void *removed) {
+    const size_t position = _cache_find(cache, key, _cache_hash(cache, key));
+    Cache_Slot *slot = _cache_slot(cache, position);
+    if (!slot->occupied) {
+        return 0;
+    }
+    if (removed != NULL) {
+        CDATA_MEMCPY(removed, _cache_element(cache, slot), cache->element_size);
+    }
+    _cache_remove_at(cache, position);
+    return 1;
+}
+
+#define _mpmc_queue_sequence(queue,position) \
+    ((size_t *)((queue)->cells + ((position) & (queue)->mask)*(queue)->cell_size))
+#define _mpmc_queue_element(queue,position) \
+    ((void *)((char *)_mpmc_queue_sequence((queue), (position)) + (queue)->element_offset))
+
+CDATA_FCN_DEF Mpmc_Queue *_mpmc_queue_new(size_t element_size, size_t capacity) {
+    capacity = round_up_2(INT_MAX(capacity, (size_t)2));
+    // The elements are aligned as required by types of their size
+    const size_t alignment = INT_MAX(CDATA_ALIGNMENT_OF_SIZE(element_size), ARENA_DEFAULT_ALIGNMENT);
+    const size_t element_offset = INT_ROUND_UP(sizeof(size_t), alignment);
+    const size_t cell_size = INT_ROUND_UP(element_offset + element_size, alignment);
+    const size_t header_size = INT_ROUND_UP(sizeof(Mpmc_Queue), alignment);
+    Mpmc_Queue *queue = CDATA_REALLOC(NULL, header_size + capacity*cell_size);
+    if (queue == NULL) {
         return NULL;
     }
-    CDATA_MEMCPY(dup, str, len);
-    return dup;
+    CDATA_MEMSET(queue, 0, sizeof(Mpmc_Queue));
+    queue->element_size = element_size;
+    queue->element_offset = element_offset;
+    queue->cell_size = cell_size;
+    queue->mask = capacity - 1;
+    queue->cells = (char *)queue + header_size;
+    // The cell of each position is ready for its producer
+    for (size_t position = 0; position < capacity; position++) {
+        *_mpmc_queue_sequence(queue, position) = position;
+    }
+    return queue;
 }
 
-CDATA_FCN_DEF char *arena_strndup(Arena *arena, const char *str, size_t len) {
-    char *dup = arena_alloc(arena, len + 1);
-    if (dup == NULL) {
+// Claims up to count consecutive positions, starting at the one pointed by
+// shared_position, whose cells are ready (their sequence numbers are the
+// position plus ready_offset). Returns the number of claimed positions, and
+// the first of them through first. Only the thread that claims a position
+// may change the sequence number of its cell, so the cells that were
+// checked are still ready if the compare-and-swap succeeds.
+CDATA_FCN_DEF size_t _mpmc_queue_claim(Mpmc_Queue *queue, size_t *shared_position, size_t ready_offset, size_t count, size_t *first) {
+    size_t position = CDATA_ATOMIC_LOAD(shared_position);
+    for (;;) {
+        size_t ready = 0;
+        intptr_t difference = 0;
+        while (ready < count) {
+            const size_t sequence = CDATA_ATOMIC_LOAD(_mpmc_queue_sequence(queue, position + ready));
+            difference = (intptr_t)(sequence - (position + ready + ready_offset));
+            if (difference != 0) {
+                break;
+            }
+            ready++;
+        }
+        if (ready > 0) {
+            // On failure, the position is updated to the current one
+            if (CDATA_ATOMIC_CAS(shared_position, &position, position + ready)) {
+                *first = position;
+                return ready;
+            }
+            CDATA_CPU_RELAX();
+        } else if (difference < 0) {
+            // The cell is still used by the previous round, so the queue is full (or empty)
+            return 0;
+        } else {
+            // Another thread already claimed the position
+            position = CDATA_ATOMIC_LOAD(shared_position);
+        }
+    }
+}
+
+CDATA_FCN_DEF size_t mpmc_queue_enqueue_batch(Mpmc_Queue *queue, const void *elements, size_t count) {
+    size_t position = 0;
+    const size_t claimed = _mpmc_queue_claim(queue, &queue->enqueue_position, 0, INT_MIN(count, mpmc_queue_capacity(queue)), &position);
+    for (size_t i = 0; i < claimed; i++) {
+        CDATA_MEMCPY(_mpmc_queue_element(queue, position + i), (const char *)elements + i*queue->element_size, queue->element_size);
+        // The cell is ready for the consumer of this position
+        CDATA_ATOMIC_STORE(_mpmc_queue_sequence(queue, position + i), position + i + 1);
+    }
+    return claimed;
+}
+
+CDATA_FCN_DEF size_t mpmc_queue_dequeue_batch(Mpmc_Queue *queue, void *elements, size_t count) {
+    size_t position = 0;
+    const size_t claimed = _mpmc_queue_claim(queue, &queue->dequeue_position, 1, INT_MIN(count, mpmc_queue_capacity(queue)), &position);
+    for (size_t i = 0; i < claimed; i++) {
+        CDATA_MEMCPY((char *)elements + i*queue->element_size, _mpmc_queue_element(queue, position + i), queue->element_size);
+        // The cell is ready for the producer of the next round
+        CDATA_ATOMIC_STORE(_mpmc_queue_sequence(queue, position + i), position + i + mpmc_queue_capacity(queue));
+    }
+    return claimed;
+}
+
+CDATA_FCN_DEF int mpmc_queue_enqueue(Mpmc_Queue *queue, const void *element) {
+    return (int)mpmc_queue_enqueue_batch(queue, element, 1);
+}
+
+CDATA_FCN_DEF int mpmc_queue_dequeue(Mpmc_Queue *queue, void *element) {
+    return (int)mpmc_queue_dequeue_batch(queue, element, 1);
+}
+
+CDATA_FCN_DEF size_t mpmc_queue_size(Mpmc_Queue *queue) {
+    const size_t dequeue_position = CDATA_ATOMIC_LOAD(&queue->dequeue_position);
+    const size_t enqueue_position = CDATA_ATOMIC_LOAD(&queue->enqueue_position);
+    // The dequeue position may pass the enqueue position that was loaded before it
+    return ((intptr_t)(enqueue_position - dequeue_position) <= 0) ? 0 :
+        INT_MIN(enqueue_position - dequeue_position, mpmc_queue_capacity(queue));
+}
+
+#ifdef CDATA_THREADS
+
+#include <unistd.h> // sysconf
+
+CDATA_FCN_DEF Thread_Pool *thread_pool_new(size_t threads) {
+    if (threads == 0) {
+        const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (processors > 0) ? (size_t)processors : 1;
+    }
+    Thread_Pool *pool = CDATA_REALLOC(NULL, sizeof(Thread_Pool));
+    if (pool == NULL) {
         return NULL;
     }
-    CDATA_MEMCPY(dup, str, len);
-    dup[len] = '\0';
-    return dup;
+    CDATA_MEMSET(pool, 0, sizeof(Thread_Pool));
+    pool->threads = threads;
+    pool->workers = CDATA_REALLOC(NULL, threads*sizeof(Thread_Pool_Worker));
+    pool->ranges = CDATA_REALLOC(NULL, threads*sizeof(Thread_Pool_Range));
+    if ((pool->workers == NULL) || (pool->ranges == NULL)) {
+        CDATA_FREE(pool->workers);
+        CDATA_FREE(pool->ranges);
+        CDATA_FREE(pool);
+        return NULL;
+    }
+    CDATA_MEMSET(pool->ranges, 0, threads*sizeof(Thread_Pool_Range));
+    const int mutex_error = pthread_mutex_init(&pool->mutex, NULL);
+    const int start_error = pthread_cond_init(&pool->start, NULL);
+    const int finish_error = pthread_cond_init(&pool->finish, NULL);
+    if ((mutex_error != 0) || (start_error != 0) || (finish_error != 0)) {
+        if (mutex_error == 0) {
+            pthread_mutex_destroy(&pool->mutex);
+        }
+        if (start_error == 0) {
+            pthread_cond_destroy(&pool->start);
+        }
+        if (finish_error == 0) {
+            pthread_cond_destroy(&pool->finish);
+        }
+        CDATA_FREE(pool->workers);
+        CDATA_FREE(pool->ranges);
+        CDATA_FREE(pool);
+        return NULL;
+    }
+    // The calling thread works as the first one
+    for (size_t i = 1; i < threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        if (pthread_create(&pool->workers[i].thread, NULL, _thread_pool_worker_run, &pool->workers[i]) != 0) {
+            // Keeps the threads that were already created
+            pool->threads = i;
+            break;
+        }
+    }
+    return pool;
 }
 
-CDATA_FCN_DEF void arena_free_all(Arena *arena) {
-    arena->current = arena->first;
-    Region *region = arena->first;
-    while (region != NULL) {
-        region->occupied = 0;
-        region = region->next;
+CDATA_FCN_DEF void thread_pool_delete(Thread_Pool *pool) {
+    if (pool == NULL) {
+        return;
     }
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+    for (size_t i = 1; i < pool->threads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&pool->finish);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->mutex);
+    CDATA_FREE(pool->workers);
+    CDATA_FREE(pool->ranges);
+    CDATA_FREE(pool);
 }
 
-CDATA_FCN_DEF void arena_delete(Arena *arena) {
-    Region *region = arena->first;
-    while (region != NULL) {
-        Region *next = region->next;
-        CDATA_FREE(region);
-        region = next;
+CDATA_FCN_DEF void *_thread_pool_worker_run(void *worker) {
+    Thread_Pool *pool = ((Thread_Pool_Worker *)worker)->pool;
+    const size_t index = ((Thread_Pool_Worker *)worker)->index;
+    // No loop was started before the workers were created. Reading the
+    // generation of the pool instead would miss a loop started before this
+    // thread runs, and the pool would wait for this worker forever.
+    size_t generation = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while ((pool->generation == generation) && !pool->stop) {
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        }
+        if (pool->stop) {
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+        _thread_pool_work(pool, index);
+        pthread_mutex_lock(&pool->mutex);
+        pool->running--;
+        if (pool->running == 0) {
+            pthread_cond_signal(&pool->finish);
+        }
     }
-    CDATA_MEMSET(arena, 0, sizeof(*arena));
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+// Takes a chunk from the beginning of the range. The chunks get smaller as
+// the range shrinks, so that the threads finish at about the same time.
+CDATA_FCN_DEF int _thread_pool_take(Thread_Pool_Range *range, size_t min_chunk, size_t *begin, size_t *end) {
+    spinlock_lock(&range->lock);
+    const size_t remaining = range->end - range->begin;
+    const size_t chunk = INT_MIN(remaining, INT_MAX(min_chunk, remaining/8));
+    *begin = range->begin;
+    *end = range->begin + chunk;
+    range->begin += chunk;
+    spinlock_unlock(&range->lock);
+    return chunk > 0;
 }
 
+// Moves the second half of what remains of the victim's range to the thief's
+// (empty) range, if it is big enough to be split
+CDATA_FCN_DEF int _thread_pool_steal(Thread_Pool_Range *victim, Thread_Pool_Range *thief, size_t min_chunk) {
+    spinlock_lock(&victim->lock);
+    const size_t remaining = victim->end - victim->begin;
+    if (remaining < 2*min_chunk) {
+        spinlock_unlock(&victim->lock);
+        return 0;
+    }
+    const size_t middle = victim->end - remaining/2;
+    const size_t end = victim->end;
+    victim->end = middle;
+    spinlock_unlock(&victim->lock);
+    spinlock_lock(&thief->lock);
+    thief->begin = middle;
+    thief->end = end;
+    spinlock_unlock(&thief->lock);
+    return 1;
+}
+
+CDATA_FCN_DEF void _thread_pool_work(Thread_Pool *pool, size_t index) {
+    size_t begin = 0;
+    size_t end = 0;
+    for (;;) {
+        while (_thread_pool_take(&pool->ranges[index], pool->min_chunk, &begin, &end)) {
+            pool->fcn(pool->context, pool->data, begin, end, index);
+        }
+        int stolen = 0;
+        for (size_t i = 1; (i < pool->threads) && !stolen; i++) {
+            stolen = _thread_pool_steal(&pool->ranges[(index + i) % pool->threads], &pool->ranges[index], pool->min_chunk);
+        }
+        if (!stolen) {
+            break;
+        }
+    }
+}
+
+CDATA_FCN_DEF void thread_pool_parallel_for(Thread_Pool *pool, size_t count, size_t min_chunk, Thread_Pool_Fcn fcn, void *data, void *context) {
+    if (count == 0) {
+        return;
+    }
+    min_chunk = INT_MAX(min_chunk, (size_t)1);
+    // The threshold is scaled by the chunk size, since an index may stand for
+    // several elements (as the words of the occupancy bitmap of a hash table)
+    if ((pool == NULL) || (pool->threads == 1) || (count/min_chunk < PARALLEL_SERIAL_THRESHOLD/PARALLEL_MIN_CHUNK)) {
+        fcn(context, data, 0, count, 0);
+        return;
+    }
+    for (size_t i = 0; i < pool->threads; i++) {
+        pool->ranges[i].begin = count*i/pool->threads;
+        pool->ranges[i].end = count*(i + 1)/pool->threads;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->fcn = fcn;
+    pool->data = data;
+    pool->context = context;
+    pool->min_chunk = min_chunk;
+    pool->running = pool->threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+    _thread_pool_work(pool, 0);
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->finish, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+CDATA_FCN_DEF void _array_parallel_reduce_range(void *context, void *data, size_t begin, size_t end, size_t thread) {
+    const Array_Parallel_Reduce_Task *task = data;
+    task->reduce(context, task->partials + thread*task->accumulator_size, task->array, begin, end);
+}
+
+CDATA_FCN_DEF void _array_parallel_reduce(Thread_Pool *pool, const void *array, size_t size, void *accumulator, size_t accumulator_size, Parallel_Reduce_Fcn reduce, Parallel_Combine_Fcn combine, void *context) {
+    if ((pool == NULL) || (pool->threads == 1) || (size < PARALLEL_SERIAL_THRESHOLD)) {
+        if (size > 0) {
+            reduce(context, accumulator, array, 0, size);
+        }
+        return;
+    }
+    Array_Parallel_Reduce_Task task = {
+        .reduce = reduce,
+        .array = array,
+        .partials = CDATA_REALLOC(NULL, pool->threads*accumulator_size),
+        .accumulator_size = accumulator_size,
+    };
+    if (task.partials == NULL) {
+        reduce(context, accumulator, array, 0, size);
+        return;
+    }
+    for (size_t i = 0; i < pool->threads; i++) {
+        CDATA_MEMCPY(task.partials + i*accumulator_size, accumulator, accumulator_size);
+    }
+    thread_pool_parallel_for(pool, size, PARALLEL_MIN_CHUNK, _array_parallel_reduce_range, &task, context);
+    for (size_t i = 0; i < pool->threads; i++) {
+        combine(context, accumulator, task.partials + i*accumulator_size);
+    }
+    CDATA_FREE(task.partials);
+}
+
+CDATA_FCN_DEF void _hash_table_parallel_for_each_range(void *context, void *data, size_t begin, size_t end, size_t thread) {
+    const Hash_Table_Parallel_Task *task = data;
+    const size_t *occupied = hash_table_occupied_pointer(task->hash_table);
+    (void)thread;
+    for (size_t word = begin; word < end; word++) {
+        size_t bits = occupied[word];
+        while (bits != 0) {
+            const size_t index = word*8*sizeof(size_t) + _bitset_ctz64((uint64_t)bits);
+            task->fcn(context, hash_table_compute_address_at(task->hash_table, task->element_size, index));
+            bits &= bits - 1;
+        }
+    }
+}
+
+CDATA_FCN_DEF void _hash_table_parallel_for_each(Thread_Pool *pool, void *hash_table, size_t element_size, Hash_Table_Parallel_Fcn fcn, void *context) {
+    Hash_Table_Parallel_Task task = {
+        .fcn = fcn,
+        .hash_table = hash_table,
+        .element_size = element_size,
+    };
+    const size_t words = INT_DIV_ROUND_UP(hash_table_capacity(hash_table), 8*sizeof(size_t));
+    // Each word holds the occupancy of 8*sizeof(size_t) slots
+    const size_t min_chunk = INT_MAX((size_t)1, PARALLEL_MIN_CHUNK/(8*sizeof(size_t)));
+    thread_pool_parallel_for(pool, words, min_chunk, _hash_table_parallel_for_each_range, &task, context);
+}
+
+#endif // CDATA_THREADS
+
 #ifdef __cplusplus
 }
 #endif
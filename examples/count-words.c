@@ -1,16 +1,32 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define CDATA_IMPLEMENTATION
 #include "cdata.h"
 
+// Words found in the text point directly to the input and are not
+// null-terminated, nor lowercased. Only the stored words are copied to the
+// arena, lowercased and null-terminated.
 typedef struct {
     char *word;
+    size_t length;
     size_t count;
 } Word;
 
@@ -34,20 +50,61 @@ typedef struct {
 // Global arena allocator
 static Arena arena = { 0 };
 
+// Lookup tables for the classification of characters, filled by init_char_classes
+#define CHAR_SPACE      (1 << 0)
+#define CHAR_PUNCT      (1 << 1)
+static unsigned char char_class[256];
+static unsigned char lowercase[256];
+
+void init_char_classes(void) {
+    for (int c = 0; c < 256; c++) {
+        char_class[c] = (unsigned char)((isspace(c) || (c == '\0')) ? CHAR_SPACE : 0);
+        char_class[c] |= (unsigned char)(ispunct(c) ? CHAR_PUNCT : 0);
+        lowercase[c] = (unsigned char)tolower(c);
+    }
+}
+
+// Case insensitive comparison, which gives the same order as strcmp over the lowercased words
 int compare_words(const void *a, const void *b) {
-    Word *word_a = (Word *)a;
-    Word *word_b = (Word *)b;
-    return strcmp(word_a->word, word_b->word);
+    const Word *word_a = a;
+    const Word *word_b = b;
+    const size_t length = INT_MIN(word_a->length, word_b->length);
+    for (size_t i = 0; i < length; i++) {
+        const int diff = lowercase[(unsigned char)word_a->word[i]] - lowercase[(unsigned char)word_b->word[i]];
+        if (diff != 0) {
+            return diff;
+        }
+    }
+    return (word_a->length > word_b->length) - (word_a->length < word_b->length);
 }
 
+char *arena_strndup_lowercase(Arena *arena, const char *str, size_t len) {
+    char *dup = arena_alloc_aligned(arena, len + 1, 1);
+    if (dup == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < len; i++) {
+        dup[i] = (char)lowercase[(unsigned char)str[i]];
+    }
+    dup[len] = '\0';
+    return dup;
+}
+
+// Words with the same count are sorted alphabetically, so that the results
+// don't depend on the order in which the words were stored
 int compare_words_by_count(const void *a, const void *b) {
-    Word *word_a = (Word *)a;
-    Word *word_b = (Word *)b;
-    return ((int)word_b->count - (int)word_a->count);
+    const Word *word_a = a;
+    const Word *word_b = b;
+    if (word_a->count != word_b->count) {
+        return (word_a->count < word_b->count) ? 1 : -1;
+    }
+    return compare_words(a, b);
 }
 
 Word *array_sort_words_descending_by_count(Word *const array) {
-    array_qsort(array, compare_words_by_count);
+    if (array_is_not_empty(array)) {
+        array_qsort(array, compare_words_by_count);
+    }
     return array;
 }
 
@@ -57,10 +114,15 @@ Word *convert_hash_table_to_sorted_array(Word *hash_table) {
     return array_sort_words_descending_by_count(array);
 }
 
+// Same as djb2 over the lowercased word
 size_t word_hash(const void *data) {
     const Word *word = data;
-    size_t value = djb2(word->word);
-    return value;
+    size_t hash = 5381;
+    for (size_t i = 0; i < word->length; i++) {
+        const char c = (char)lowercase[(unsigned char)word->word[i]];
+        hash = ((hash << 5) + hash) + (size_t)c;
+    }
+    return hash;
 }
 
 Word *array_init(void) {
@@ -76,9 +138,8 @@ void array_deinit(Word *array) {
     array_delete(array);
 }
 
-void array_display_results(Word *const array, size_t number_of_words) {
-    printf("    unique words: %zu\n", array_size(array));
-    number_of_words = INT_MIN(number_of_words, array_size(array));
+void display_top_words(Word *const array, size_t number_of_words) {
+    number_of_words = INT_MIN(number_of_words, (array_is_empty(array) ? 0 : array_size(array)));
     if (number_of_words > 0) {
         printf("    top %zu words:\n", number_of_words);
         for (size_t i = 0; i < number_of_words; i++) {
@@ -87,13 +148,20 @@ void array_display_results(Word *const array, size_t number_of_words) {
     }
 }
 
+void array_display_results(Word *const array, size_t number_of_words) {
+    const size_t unique_words = array_is_empty(array) ? 0 : array_size(array);
+    printf("    unique words: %zu\n", unique_words);
+    display_top_words(array, number_of_words);
+}
+
 Word *sequential_algorithm(Word *array, const Word word) {
     const size_t index = array_sequential_search(array, &word, compare_words);
     if (array_index_is_valid(array, index)) {
         array_at(array, index).count++;
     } else {
         Word new_word = {
-            .word = arena_strdup(&arena, word.word),
+            .word = arena_strndup_lowercase(&arena, word.word, word.length),
+            .length = word.length,
             .count = 1,
         };
         array_push(array, new_word);
@@ -105,7 +173,8 @@ Word *sorted_algorithm(Word *array, const Word word) {
     size_t index = (size_t)-1;
     if (array_insert_sorted(array, &word, compare_words, &index)) {
         array_at(array, index) = (Word) {
-            .word = arena_strdup(&arena, word.word),
+            .word = arena_strndup_lowercase(&arena, word.word, word.length),
+            .length = word.length,
             .count = 1,
         };
     } else {
@@ -118,7 +187,8 @@ Word *hash_algorithm(Word *hash_table, const Word word) {
     Word *stored = NULL;
     if (hash_table_insert(hash_table, &word, &stored)) {
         *stored = (Word) {
-            .word = arena_strdup(&arena, word.word),
+            .word = arena_strndup_lowercase(&arena, word.word, word.length),
+            .length = word.length,
             .count = 1,
         };
     } else {
@@ -127,6 +197,170 @@ Word *hash_algorithm(Word *hash_table, const Word word) {
     return hash_table;
 }
 
+// The heavy hitters algorithm only keeps a fixed number of counters, and each
+// counter owns a buffer for its word, so its memory usage is bounded
+typedef struct {
+    char *data;
+    size_t capacity;
+} Word_Buffer;
+
+// Copies the lowercased word to the buffer, growing it if needed
+char *word_buffer_lowercase(Word_Buffer *buffer, const Word word) {
+    if (buffer->capacity <= word.length) {
+        buffer->capacity = round_up_2(word.length + 1);
+        buffer->data = realloc(buffer->data, buffer->capacity);
+        assert(buffer->data != NULL);
+    }
+    for (size_t i = 0; i < word.length; i++) {
+        buffer->data[i] = (char)lowercase[(unsigned char)word.word[i]];
+    }
+    buffer->data[word.length] = '\0';
+    return buffer->data;
+}
+
+static size_t heavy_hitters_counters = 1024;
+static Heavy_Hitters *heavy_hitters = NULL;
+static Word_Buffer *heavy_hitters_buffers = NULL;
+
+Word *heavy_hitters_init(void) {
+    heavy_hitters = heavy_hitters_new(Word, word_hash, compare_words, heavy_hitters_counters);
+    heavy_hitters_buffers = calloc(heavy_hitters_counters, sizeof(Word_Buffer));
+    assert((heavy_hitters != NULL) && (heavy_hitters_buffers != NULL));
+    return NULL;
+}
+
+Word *heavy_hitters_algorithm(Word *data, const Word word) {
+    Word *stored = NULL;
+    if (heavy_hitters_add(heavy_hitters, &word, &stored)) {
+        Word_Buffer *buffer = &heavy_hitters_buffers[heavy_hitters_index_of(heavy_hitters, stored)];
+        stored->word = word_buffer_lowercase(buffer, word);
+    }
+    return data;
+}
+
+Word *heavy_hitters_to_sorted_array(Word *const data) {
+    (void)data;
+    Word *array = NULL;
+    size_t *indexes = heavy_hitters_sorted_indexes(heavy_hitters);
+    array_for_each(indexes, index) {
+        Word word = *(Word *)heavy_hitters_element_at(heavy_hitters, *index);
+        word.count = heavy_hitters_count_at(heavy_hitters, *index);
+        array_push(array, word);
+    }
+    array_delete(indexes);
+    return array_sort_words_descending_by_count(array);
+}
+
+void heavy_hitters_display_results(Word *const array, size_t number_of_words) {
+    printf("    counters: %zu\n", heavy_hitters_capacity(heavy_hitters));
+    printf("    counts overestimated by at most: %zu\n", heavy_hitters_max_error(heavy_hitters));
+    // Only the words kept by the counters are known, not all the unique ones
+    printf("    tracked words: %zu\n", array_is_empty(array) ? (size_t)0 : array_size(array));
+    display_top_words(array, number_of_words);
+}
+
+void heavy_hitters_deinit(Word *array) {
+    array_delete(array);
+    for (size_t i = 0; i < heavy_hitters_counters; i++) {
+        free(heavy_hitters_buffers[i].data);
+    }
+    free(heavy_hitters_buffers);
+    heavy_hitters_delete(heavy_hitters);
+    heavy_hitters_buffers = NULL;
+    heavy_hitters = NULL;
+}
+
+// The radix tree stores its own copy of the keys, and each leaf holds the
+// count of its word
+static Radix_Tree radix_tree = { 0 };
+static Word_Buffer radix_tree_key = { 0 };
+
+Word *radix_tree_init(void) {
+    radix_tree = radix_tree_new(size_t, &arena);
+    return NULL;
+}
+
+Word *radix_tree_algorithm(Word *data, const Word word) {
+    size_t *count = NULL;
+    const char *key = word_buffer_lowercase(&radix_tree_key, word);
+    if (radix_tree_insert(&radix_tree, key, word.length, &count) < 0) {
+        fprintf(stderr, "Error: Could not allocate memory to insert a word in the radix tree\n");
+        exit(EXIT_FAILURE);
+    }
+    (*count)++;
+    return data;
+}
+
+int radix_tree_push_word(void *context, const char *key, size_t length, void *value) {
+    Word **array = context;
+    Word word = {
+        .word = (char *)key,
+        .length = length,
+        .count = *(size_t *)value,
+    };
+    array_push(*array, word);
+    return 0;
+}
+
+Word *radix_tree_to_sorted_array(Word *const data) {
+    (void)data;
+    Word *array = NULL;
+    radix_tree_for_each(&radix_tree, radix_tree_push_word, &array);
+    return array_sort_words_descending_by_count(array);
+}
+
+void radix_tree_deinit(Word *array) {
+    array_delete(array);
+    free(radix_tree_key.data);
+    radix_tree_key = (Word_Buffer) { 0 };
+}
+
+// The interner maps each word to a dense symbol, which indexes the counts
+static Interner interner = { 0 };
+static size_t *symbol_counts = NULL;
+static Word_Buffer interner_key = { 0 };
+
+Word *interner_init(void) {
+    return NULL;
+}
+
+Word *interner_algorithm(Word *data, const Word word) {
+    const char *key = word_buffer_lowercase(&interner_key, word);
+    const Symbol symbol = interner_intern(&interner, key, word.length);
+    if (symbol == SYMBOL_INVALID) {
+        fprintf(stderr, "Error: Could not allocate memory to intern a word\n");
+        exit(EXIT_FAILURE);
+    }
+    if (symbol == (array_is_empty(symbol_counts) ? 0 : array_size(symbol_counts))) {
+        array_push(symbol_counts, 0);
+    }
+    symbol_counts[symbol]++;
+    return data;
+}
+
+Word *interner_to_sorted_array(Word *const data) {
+    (void)data;
+    Word *array = NULL;
+    for (size_t symbol = 0; symbol < interner_size(&interner); symbol++) {
+        Word word = {
+            .word = (char *)interner_string(&interner, symbol),
+            .length = interner_length(&interner, symbol),
+            .count = symbol_counts[symbol],
+        };
+        array_push(array, word);
+    }
+    return array_sort_words_descending_by_count(array);
+}
+
+void interner_deinit(Word *array) {
+    array_delete(array);
+    array_delete(symbol_counts);
+    symbol_counts = NULL;
+    interner_delete(&interner);
+    free(interner_key.data);
+    interner_key = (Word_Buffer) { 0 };
+}
+
 static const Algorithm algorithms[] = {
     {
         .name = "dynamic array",
@@ -158,61 +392,240 @@ static const Algorithm algorithms[] = {
         .display_results = array_display_results,
         .deinit = array_deinit,
     },
+    {
+        .name = "heavy hitters",
+        .arg_option = 'a',
+        .help_msg = "Uses approximate heavy hitters algorithm, with bounded memory",
+        .init = heavy_hitters_init,
+        .process_word = heavy_hitters_algorithm,
+        .post_process = heavy_hitters_to_sorted_array,
+        .display_results = heavy_hitters_display_results,
+        .deinit = heavy_hitters_deinit,
+    },
+    {
+        .name = "radix tree",
+        .arg_option = 'r',
+        .help_msg = "Uses radix tree algorithm",
+        .init = radix_tree_init,
+        .process_word = radix_tree_algorithm,
+        .post_process = radix_tree_to_sorted_array,
+        .display_results = array_display_results,
+        .deinit = radix_tree_deinit,
+    },
+    {
+        .name = "string interner",
+        .arg_option = 'i',
+        .help_msg = "Uses string interner algorithm, counting the words by their symbols",
+        .init = interner_init,
+        .process_word = interner_algorithm,
+        .post_process = interner_to_sorted_array,
+        .display_results = array_display_results,
+        .deinit = interner_deinit,
+    },
 };
 
-void copy_sized_str_to_cstr_lowercase(char *dst, const char *src, size_t len) {
-    for (size_t i = 0; (src[i] != '\0') && (i < len); i++) {
-        dst[i] = (char)tolower(src[i]);
+typedef struct {
+    size_t lines;
+    size_t chars;
+    size_t words;
+    char last_char;
+} Text_Stats;
+
+// Called for every word found in the text
+typedef void (*Word_Fcn)(void *context, const Word word);
+
+#define BLOCK_SIZE          64
+#define NO_WORD             ((size_t)-1)
+// Input from pipes and other files that can't be mapped is read in blocks of this size
+#define READ_BUFFER_SIZE    (1 << 20)
+
+#ifdef __SSE2__
+// Mask with 0xFF in the bytes whose value is in the range [low, high]
+static inline __m128i in_range(const __m128i c, const char low, const char high) {
+    const __m128i shifted = _mm_sub_epi8(c, _mm_set1_epi8(low));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8((char)(high - low))), shifted);
+}
+#endif
+
+// Computes bitmasks of the characters in the block that are whitespaces,
+// delimiters (whitespaces or punctuation) and newlines
+static inline void classify_block(const char *block, uint64_t *space, uint64_t *delimiter, uint64_t *newline) {
+    *space = *delimiter = *newline = 0;
+#ifdef __SSE2__
+    for (int i = 0; i < BLOCK_SIZE; i += 16) {
+        const __m128i c = _mm_loadu_si128((const __m128i *)(block + i));
+        const __m128i is_newline = _mm_cmpeq_epi8(c, _mm_set1_epi8('\n'));
+        const __m128i is_space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(c, _mm_setzero_si128())),
+            in_range(c, '\t', '\r'));
+        const __m128i is_punct = _mm_or_si128(
+            _mm_or_si128(in_range(c, '!', '/'), in_range(c, ':', '@')),
+            _mm_or_si128(in_range(c, '[', '`'), in_range(c, '{', '~')));
+        *space |= (uint64_t)(unsigned)_mm_movemask_epi8(is_space) << i;
+        *delimiter |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_or_si128(is_space, is_punct)) << i;
+        *newline |= (uint64_t)(unsigned)_mm_movemask_epi8(is_newline) << i;
     }
-    dst[len] = '\0';
+#else
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        const unsigned char c = (unsigned char)block[i];
+        *space |= (uint64_t)((char_class[c] & CHAR_SPACE) != 0) << i;
+        *delimiter |= (uint64_t)(char_class[c] != 0) << i;
+        *newline |= (uint64_t)(c == '\n') << i;
+    }
+#endif
 }
 
-int process_file(const char *const filename, const Algorithm algorithm, int print_header, size_t number_of_words) {
-    clock_t tic = clock();
-    FILE *const file = fopen(filename, "rb");
-    if (file == NULL) {
+static inline int popcount64(uint64_t x) {
+    return __builtin_popcountll(x);
+}
+
+static inline int ctz64(uint64_t x) {
+    return __builtin_ctzll(x);
+}
+
+// A word begins in a character that is neither a whitespace nor punctuation,
+// and ends right before the next whitespace. If it isn't the final part of the
+// input, the last word may be incomplete, so it isn't processed. In this case,
+// the function returns the offset where this word begins.
+size_t tokenize(const char *const data, const size_t size, const int final, Word_Fcn process, void *context, Text_Stats *const stats) {
+    size_t start = NO_WORD;
+    for (size_t offset = 0; offset < size; offset += BLOCK_SIZE) {
+        uint64_t space, delimiter, newline;
+        if (size - offset >= BLOCK_SIZE) {
+            classify_block(data + offset, &space, &delimiter, &newline);
+        } else {
+            // Pads the last block, so that a word touching the end of the input
+            // is only finished if this is the final part of it
+            char block[BLOCK_SIZE];
+            memset(block, final ? ' ' : 'a', sizeof(block));
+            memcpy(block, data + offset, size - offset);
+            classify_block(block, &space, &delimiter, &newline);
+        }
+        stats->lines += (size_t)popcount64(newline);
+        // Bits of the characters after the current position in the block
+        uint64_t remaining = ~(uint64_t)0;
+        while (remaining != 0) {
+            if (start == NO_WORD) {
+                const uint64_t begin = ~delimiter & remaining;
+                if (begin == 0) {
+                    break;
+                }
+                const int bit = ctz64(begin);
+                start = offset + (size_t)bit;
+                remaining = ~(uint64_t)0 << bit;
+            }
+            const uint64_t end = space & remaining;
+            if (end == 0) {
+                break;
+            }
+            const int bit = ctz64(end);
+            const Word word = {
+                .word = (char *)data + start,
+                .length = offset + (size_t)bit - start,
+            };
+            process(context, word);
+            stats->words++;
+            start = NO_WORD;
+            remaining = (bit == BLOCK_SIZE - 1) ? 0 : (~(uint64_t)0 << (bit + 1));
+        }
+    }
+    if (size > 0) {
+        stats->last_char = data[size - 1];
+    }
+    return ((start == NO_WORD) || (start > size)) ? size : start;
+}
+
+// Regular files are mapped into memory, while pipes are read in large blocks
+int tokenize_file(const char *const filename, Word_Fcn process, void *context, Text_Stats *const stats) {
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         fprintf(stderr, "Error: Could not open file \"%s\": %s\n", filename, strerror(errno));
         return EXIT_FAILURE;
     }
-    char tmp_buffer[4096];
-    char buffer[4096];
-    Word *data = algorithm.init();
-    size_t lines = 0, chars = 0, words = 0;
-    while (fgets(buffer, sizeof(buffer), file) != NULL) {
-        char *str = buffer;
-        chars += strlen(str);
-        while (*str) {
-            while (isspace(*str) || ispunct(*str)) {
-                str++;
-            }
-            size_t word_len = 0;
-            while (*str && !isspace(str[word_len]) && !ispunct(*str)) {
-                word_len++;
+    int result = EXIT_SUCCESS;
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+        const size_t size = (size_t)st.st_size;
+        char *const data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+            tokenize(data, size, 1, process, context, stats);
+            stats->chars += size;
+            munmap(data, size);
+            goto done;
+        }
+    }
+    char *buffer = NULL;
+    size_t capacity = READ_BUFFER_SIZE;
+    size_t length = 0;
+    for (;;) {
+        if ((buffer == NULL) || (length == capacity)) {
+            // A single word filled the whole buffer
+            capacity = (buffer == NULL) ? capacity : GROWTH_FACTOR*capacity;
+            char *new_buffer = realloc(buffer, capacity);
+            if (new_buffer == NULL) {
+                fprintf(stderr, "Error: Could not allocate memory to read file \"%s\"\n", filename);
+                result = EXIT_FAILURE;
+                break;
             }
-            if (word_len > 0) {
-                words++;
-                assert(word_len < sizeof(tmp_buffer));
-                copy_sized_str_to_cstr_lowercase(tmp_buffer, str, word_len);
-                Word word_found = { .word = tmp_buffer };
-                data = algorithm.process_word(data, word_found);
+            buffer = new_buffer;
+        }
+        const ssize_t bytes = read(fd, buffer + length, capacity - length);
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
             }
-            str += word_len;
+            fprintf(stderr, "Error: Could not read file \"%s\": %s\n", filename, strerror(errno));
+            result = EXIT_FAILURE;
+            break;
+        }
+        const int final = (bytes == 0);
+        length += (size_t)bytes;
+        stats->chars += (size_t)bytes;
+        // The beginning of an incomplete word is moved to the start of the buffer
+        const size_t consumed = tokenize(buffer, length, final, process, context, stats);
+        memmove(buffer, buffer + consumed, length - consumed);
+        length -= consumed;
+        if (final) {
+            break;
         }
-        lines++;
     }
-    int result = EXIT_SUCCESS;
-    if (!feof(file)) {
-        fprintf(stderr, "Error: Didn't reach the end of file \"%s\"\n", filename);
-        result = EXIT_FAILURE;
+    free(buffer);
+done:
+    if ((stats->chars > 0) && (stats->last_char != '\n')) {
+        // The last line doesn't end with a newline
+        stats->lines++;
     }
-    data = algorithm.post_process(data);
+    close(fd);
+    return result;
+}
+
+typedef struct {
+    Algorithm algorithm;
+    Word *data;
+} Process_Context;
+
+void process_word(void *context, const Word word) {
+    Process_Context *const process = context;
+    process->data = process->algorithm.process_word(process->data, word);
+}
+
+int process_file(const char *const filename, const Algorithm algorithm, int print_header, size_t number_of_words) {
+    clock_t tic = clock();
+    Process_Context context = {
+        .algorithm = algorithm,
+        .data = algorithm.init(),
+    };
+    Text_Stats stats = { 0 };
+    int result = tokenize_file(filename, process_word, &context, &stats);
+    Word *data = algorithm.post_process(context.data);
     clock_t toc = clock();
     if (result == EXIT_SUCCESS) {
         if (print_header) {
             printf("File: %s\n", filename);
-            printf("  lines: %zu\n", lines);
-            printf("  chars: %zu\n", chars);
-            printf("  words: %zu\n", words);
+            printf("  lines: %zu\n", stats.lines);
+            printf("  chars: %zu\n", stats.chars);
+            printf("  words: %zu\n", stats.words);
         }
         printf("  algorithm: %s\n", algorithm.name);
         printf("    execution time: %gs\n", (double)(toc - tic) / CLOCKS_PER_SEC);
@@ -220,7 +633,250 @@ int process_file(const char *const filename, const Algorithm algorithm, int prin
     }
     algorithm.deinit(data);
     arena_free_all(&arena);
-    fclose(file);
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// Parallel hash table algorithm
+// Each file is split in chunks aligned to newlines, and the chunks of all the
+// files are processed by a pool of threads. Each thread counts the words in
+// its own hash tables (one per file) and arena, and then the tables of all the
+// threads are merged into the result of each file.
+
+// Chunks are never smaller than this, to amortize the cost of scheduling them
+#define MIN_CHUNK_SIZE      (1 << 20)
+
+typedef struct {
+    size_t file;
+    // A chunk with data == NULL means that the whole file should be read with
+    // tokenize_file, because it couldn't be mapped into memory (pipes, for instance)
+    const char *data;
+    size_t size;
+} Chunk;
+
+typedef struct {
+    const char *filename;
+    char *data; // Mapped file, or NULL
+    size_t size;
+    int stream; // The file couldn't be mapped, so it is read with tokenize_file
+    Text_Stats stats;
+    Word *result;
+} Parallel_File;
+
+typedef struct {
+    Parallel_File *files;
+    Chunk *chunks;
+    size_t next_chunk;
+    int failed;
+} Parallel_Job;
+
+typedef struct {
+    pthread_t thread;
+    Parallel_Job *job;
+    Arena arena;
+    Word **tables; // One hash table per file
+    Text_Stats *stats; // One per file
+} Worker;
+
+typedef struct {
+    Worker *worker;
+    Word **table;
+} Worker_Context;
+
+void parallel_hash_word(void *context, const Word word) {
+    Worker_Context *const worker_context = context;
+    Word *stored = NULL;
+    if (hash_table_insert(*worker_context->table, &word, &stored)) {
+        *stored = (Word) {
+            .word = arena_strndup_lowercase(&worker_context->worker->arena, word.word, word.length),
+            .length = word.length,
+            .count = 1,
+        };
+    } else {
+        stored->count++;
+    }
+}
+
+void *worker_run(void *arg) {
+    Worker *const worker = arg;
+    Parallel_Job *const job = worker->job;
+    const size_t number_of_chunks = (job->chunks != NULL) ? array_size(job->chunks) : 0;
+    for (;;) {
+        const size_t index = CDATA_ATOMIC_FETCH_ADD(&job->next_chunk, 1);
+        if (index >= number_of_chunks) {
+            break;
+        }
+        const Chunk chunk = job->chunks[index];
+        Worker_Context context = {
+            .worker = worker,
+            .table = &worker->tables[chunk.file],
+        };
+        Text_Stats *const stats = &worker->stats[chunk.file];
+        if (chunk.data != NULL) {
+            tokenize(chunk.data, chunk.size, 1, parallel_hash_word, &context, stats);
+        } else if (tokenize_file(job->files[chunk.file].filename, parallel_hash_word, &context, stats)) {
+            CDATA_ATOMIC_STORE(&job->failed, 1);
+        }
+    }
+    return NULL;
+}
+
+// Adds the counts of the words in the source table to the destination table
+Word *merge_hash_tables(Word *destination, Word *source) {
+    hash_table_for_each(source, index, it) {
+        Word *stored = NULL;
+        if (!hash_table_insert(destination, it, &stored)) {
+            stored->count += it->count;
+        }
+    }
+    return destination;
+}
+
+int map_file(Parallel_File *const file) {
+    const int fd = open(file->filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open file \"%s\": %s\n", file->filename, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    // Files that can't be inspected are read as streams
+    struct stat st;
+    const int is_regular = (fstat(fd, &st) == 0) && S_ISREG(st.st_mode);
+    if (is_regular && (st.st_size > 0)) {
+        const size_t size = (size_t)st.st_size;
+        char *const data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+            file->data = data;
+            file->size = size;
+            file->stats.chars = size;
+            file->stats.last_char = data[size - 1];
+        }
+    }
+    // Empty regular files have nothing to be processed
+    file->stream = (file->data == NULL) && !(is_regular && (st.st_size == 0));
+    close(fd);
+    return EXIT_SUCCESS;
+}
+
+// Splits the file in chunks that end right after a newline, so that words are never split
+void split_in_chunks(Parallel_Job *const job, const size_t file_index, const size_t number_of_threads) {
+    const Parallel_File *const file = &job->files[file_index];
+    if (file->stream) {
+        Chunk chunk = { .file = file_index };
+        array_push(job->chunks, chunk);
+        return;
+    }
+    const size_t chunk_size = INT_MAX((size_t)MIN_CHUNK_SIZE, file->size / (4*number_of_threads));
+    size_t offset = 0;
+    while (offset < file->size) {
+        size_t end = file->size;
+        if (file->size - offset > chunk_size) {
+            const char *newline = memchr(file->data + offset + chunk_size, '\n', file->size - offset - chunk_size);
+            if (newline != NULL) {
+                end = (size_t)(newline - file->data) + 1;
+            }
+        }
+        Chunk chunk = {
+            .file = file_index,
+            .data = file->data + offset,
+            .size = end - offset,
+        };
+        array_push(job->chunks, chunk);
+        offset = end;
+    }
+}
+
+void display_parallel_result(const Parallel_File *const file, int print_header, size_t number_of_words, double execution_time, size_t number_of_threads) {
+    if (print_header) {
+        printf("File: %s\n", file->filename);
+        printf("  lines: %zu\n", file->stats.lines);
+        printf("  chars: %zu\n", file->stats.chars);
+        printf("  words: %zu\n", file->stats.words);
+    }
+    printf("  algorithm: hash table\n");
+    printf("    execution time: %gs (wall clock of all files, %zu threads)\n", execution_time, number_of_threads);
+    array_display_results(file->result, number_of_words);
+}
+
+double wall_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec*1e-9;
+}
+
+// Processes all the files with the hash table algorithm, using several threads.
+// The results are stored in the files, and the strings of the words are kept
+// in the arenas of the workers, which should be deleted later.
+int process_files_parallel(Parallel_File *const files, Worker *const workers, double *const execution_time) {
+    const double tic = wall_clock();
+    const size_t number_of_threads = array_size(workers);
+    Parallel_Job job = { .files = files };
+    array_for(files, i) {
+        if (map_file(&files[i])) {
+            return EXIT_FAILURE;
+        }
+        split_in_chunks(&job, i, number_of_threads);
+    }
+    array_for(workers, i) {
+        Worker *const worker = &workers[i];
+        worker->job = &job;
+        array_for(files, j) {
+            Word *table = hash_table_init();
+            array_push(worker->tables, table);
+            Text_Stats stats = { 0 };
+            array_push(worker->stats, stats);
+        }
+    }
+    int result = EXIT_SUCCESS;
+    // The main thread also works as the first worker
+    for (size_t i = 1; i < number_of_threads; i++) {
+        const int error = pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]);
+        if (error != 0) {
+            fprintf(stderr, "Error: Could not create thread: %s\n", strerror(error));
+            exit(EXIT_FAILURE);
+        }
+    }
+    worker_run(&workers[0]);
+    for (size_t i = 1; i < number_of_threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    if (job.failed) {
+        result = EXIT_FAILURE;
+    }
+    // Merges the tables of all the workers into the biggest one
+    array_for(files, i) {
+        Parallel_File *const file = &files[i];
+        size_t biggest = 0;
+        array_for(workers, j) {
+            if (hash_table_size(workers[j].tables[i]) > hash_table_size(workers[biggest].tables[i])) {
+                biggest = j;
+            }
+        }
+        Word *table = workers[biggest].tables[i];
+        array_for(workers, j) {
+            const Text_Stats stats = workers[j].stats[i];
+            file->stats.lines += stats.lines;
+            file->stats.words += stats.words;
+            if (file->stream) {
+                // Stats of files that were read with tokenize_file
+                file->stats.chars += stats.chars;
+            }
+            if (j != biggest) {
+                table = merge_hash_tables(table, workers[j].tables[i]);
+                hash_table_delete(workers[j].tables[i]);
+            }
+        }
+        if (file->data != NULL) {
+            if (file->stats.last_char != '\n') {
+                file->stats.lines++;
+            }
+            munmap(file->data, file->size);
+            file->data = NULL;
+        }
+        file->result = convert_hash_table_to_sorted_array(table);
+    }
+    array_delete(job.chunks);
+    *execution_time = wall_clock() - tic;
     return result;
 }
 
@@ -251,6 +907,8 @@ void usage(FILE *const stream, const char *const  program_name) {
         fprintf(stream, "  -%c                       %s\n", algorithm.arg_option, algorithm.help_msg);
     }
     fprintf(stream, "  -n  <unsigned integer>   Specifies the number of most used words to display\n");
+    fprintf(stream, "  -j  <unsigned integer>   Number of threads used by the hash table algorithm\n");
+    fprintf(stream, "  -k  <unsigned integer>   Number of counters used by the heavy hitters algorithm\n");
     fprintf(stream, "  -h                       Display this help message\n");
 }
 
@@ -263,9 +921,11 @@ int main(const int argc, const char *const argv[])
         usage(stderr, program_name);
         return EXIT_FAILURE;
     }
+    init_char_classes();
     int active_algorithms = 0 ;
     char **filenames = NULL;
     size_t number_of_words = 10;
+    size_t number_of_threads = 1;
     // First, process all arguments, and append all filenames to a list, for later processing
     for (int i = 1; i < argc; i++) {
         const char *const arg = argv[i];
@@ -298,6 +958,30 @@ int main(const int argc, const char *const argv[])
                 return EXIT_FAILURE;
             }
         } break;
+        case 'j': {
+            if (++i == argc) {
+                fprintf(stderr, "Error: Argument %s should be followed by a integer number\n", arg);
+                usage(stderr, program_name);
+                return EXIT_FAILURE;
+            }
+            if ((parse_uint(argv[i], &number_of_threads) == EXIT_FAILURE) || (number_of_threads == 0)) {
+                fprintf(stderr, "Error: %s is not a valid number of threads\n", argv[i]);
+                usage(stderr, program_name);
+                return EXIT_FAILURE;
+            }
+        } break;
+        case 'k': {
+            if (++i == argc) {
+                fprintf(stderr, "Error: Argument %s should be followed by a integer number\n", arg);
+                usage(stderr, program_name);
+                return EXIT_FAILURE;
+            }
+            if ((parse_uint(argv[i], &heavy_hitters_counters) == EXIT_FAILURE) || (heavy_hitters_counters == 0)) {
+                fprintf(stderr, "Error: %s is not a valid number of counters\n", argv[i]);
+                usage(stderr, program_name);
+                return EXIT_FAILURE;
+            }
+        } break;
         case 'h':
             usage(stdout, program_name);
             return EXIT_SUCCESS;
@@ -316,21 +1000,57 @@ int main(const int argc, const char *const argv[])
         usage(stderr, program_name);
         return EXIT_FAILURE;
     }
+    // With more than one thread, the hash table algorithm processes all the files at once
+    const size_t hash_table_algorithm = algorithm_option('t');
+    Parallel_File *parallel_files = NULL;
+    Worker *workers = NULL;
+    double parallel_time = 0.0;
+    if ((number_of_threads > 1) && TEST_BIT(active_algorithms, hash_table_algorithm)) {
+        array_for_each(filenames, filename) {
+            Parallel_File file = { .filename = *filename };
+            array_push(parallel_files, file);
+        }
+        for (size_t i = 0; i < number_of_threads; i++) {
+            Worker worker = { 0 };
+            array_push(workers, worker);
+        }
+        if (process_files_parallel(parallel_files, workers, &parallel_time)) {
+            // The error was already reported
+            return EXIT_FAILURE;
+        }
+    }
     // Process each file using the specified algorithms
-    array_for_each(filenames, filename) {
+    array_for(filenames, i) {
         int print_header = 1;
         for (size_t j = 0; j < STATIC_ARRAY_SIZE(algorithms); j++) {
+            if ((parallel_files != NULL) && (j == hash_table_algorithm)) {
+                display_parallel_result(&parallel_files[i], print_header, number_of_words, parallel_time, number_of_threads);
+                print_header = 0;
+                continue;
+            }
             if (!TEST_BIT(active_algorithms, j)) {
                 continue;
             }
-            if (process_file(*filename, algorithms[j], print_header, number_of_words)) {
+            if (process_file(filenames[i], algorithms[j], print_header, number_of_words)) {
                 // The error was already reported in process_file
                 return EXIT_FAILURE;
             }
             print_header = 0;
         }
     }
+    array_for_each(parallel_files, file) {
+        array_delete(file->result);
+    }
+    array_for_each(workers, worker) {
+        array_delete(worker->tables);
+        array_delete(worker->stats);
+        arena_delete(&worker->arena);
+    }
+    array_delete(parallel_files);
+    array_delete(workers);
     array_delete(filenames);
     arena_delete(&arena);
+    // Only prints something when compiled with -DCDATA_STATS
+    cdata_stats_dump(stderr);
     return EXIT_SUCCESS;
 }